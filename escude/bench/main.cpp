@@ -0,0 +1,464 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "../common/byte_order.h"
+#include "../common/escr1_00_format.h"
+#include "../common/escude_script_format.h"
+#include "../common/script_tool.h"
+
+namespace fs = std::filesystem;
+
+// 性能测试
+// 生成与真实脚本结构相同的合成语料, 通过script_tool的命令行入口测量单文件和批量模式的提取, 修改和往返耗时,
+// 结果以JSON格式输出, 便于在不同提交之间比较
+
+// 语料生成参数
+struct CorpusConfig {
+    uint32_t stringCount = 200;   // 每个文件的字符串数量
+    uint32_t minLength = 4;       // 字符串最短字节数
+    uint32_t maxLength = 60;      // 字符串最长字节数
+    uint32_t bytecodeSize = 4096; // 字节码(控制部分)字节数
+    uint64_t seed = 1;
+};
+
+// 生成的脚本变体
+enum class ScriptVariant {
+    Escr1_00,
+    EscudeOneSegment,
+    EscudeTwoSegments,
+};
+
+const ScriptVariant allVariants[] = {ScriptVariant::Escr1_00, ScriptVariant::EscudeOneSegment, ScriptVariant::EscudeTwoSegments};
+
+const char* variantName(ScriptVariant variant) {
+    switch (variant) {
+    case ScriptVariant::Escr1_00:
+        return "escr1_00";
+    case ScriptVariant::EscudeOneSegment:
+        return "escude_one_segment";
+    case ScriptVariant::EscudeTwoSegments:
+        return "escude_two_segments";
+    }
+    return "";
+}
+
+// 合成语料生成器
+// 字符串由ASCII字符和SJIS双字节字符混合组成, 不含\0和换行符
+class CorpusGenerator {
+public:
+    explicit CorpusGenerator(const CorpusConfig& config) : config_(config), random_(config.seed) {}
+
+    // 生成一个脚本文件和对应的txt文件内容
+    void generate(ScriptVariant variant, std::vector<uint8_t>& script, std::string& text) {
+        std::vector<std::string> strings(config_.stringCount);
+        for (std::string& s : strings) {
+            s = randomString();
+        }
+        std::vector<uint8_t> bytecode(config_.bytecodeSize);
+        for (uint8_t& b : bytecode) {
+            b = static_cast<uint8_t>(random_());
+        }
+
+        script.clear();
+        text.clear();
+        if (variant == ScriptVariant::Escr1_00) {
+            buildEscr1_00(strings, bytecode, script);
+            for (const std::string& s : strings) {
+                text += s;
+                text += "\r\n";
+            }
+        } else {
+            buildEscudeScript(strings, bytecode, variant == ScriptVariant::EscudeTwoSegments, script);
+            for (const std::string& s : strings) {
+                text += s;
+                text += '\n';
+            }
+        }
+    }
+
+private:
+    std::string randomString() {
+        uint32_t length = config_.minLength + static_cast<uint32_t>(random_() % (config_.maxLength - config_.minLength + 1));
+        std::string s;
+        while (s.size() < length) {
+            if (s.size() + 1 < length && random_() % 10 < 7) {
+                appendSjisCharacter(s);
+            } else {
+                s += static_cast<char>(0x20 + random_() % 0x5F);
+            }
+        }
+        return s;
+    }
+
+    // SJIS双字节字符, 只使用CP932中已分配的区域: 平假名0x829F-0x82F1, 片假名0x8340-0x8396, 第一水准汉字0x889F-0x9872
+    // 第二字节0x40-0xFC中跳过0x7F, 每个第一字节有188个位置
+    void appendSjisCharacter(std::string& s) {
+        uint32_t kind = static_cast<uint32_t>(random_() % 10);
+        uint32_t lead;
+        uint32_t cell;
+        if (kind < 5) {
+            lead = 0x82;
+            cell = 0x9F - 0x41 + static_cast<uint32_t>(random_() % 83);
+        } else if (kind < 7) {
+            lead = 0x83;
+            cell = static_cast<uint32_t>(random_() % 86);
+        } else {
+            uint32_t position = 0x88 * 188 + (0x9F - 0x41) + static_cast<uint32_t>(random_() % 2965);
+            lead = position / 188;
+            cell = position % 188;
+        }
+        s += static_cast<char>(lead);
+        s += static_cast<char>(cell < 0x3F ? 0x40 + cell : 0x41 + cell);
+    }
+
+    static void appendString(std::vector<uint8_t>& out, const std::string& s) {
+        out.insert(out.end(), s.begin(), s.end());
+        out.push_back(0);
+    }
+
+    static void append32(std::vector<uint8_t>& out, uint32_t value) {
+        uint8_t bytes[4];
+        writeLittleEndian32(bytes, value);
+        out.insert(out.end(), bytes, bytes + 4);
+    }
+
+    // 文本段: 索引表和数据区域
+    static void appendSegment(std::vector<uint8_t>& out, const std::string* begin, const std::string* end, uint32_t& dataLength) {
+        std::vector<uint8_t> pool;
+        for (const std::string* s = begin; s != end; ++s) {
+            append32(out, static_cast<uint32_t>(pool.size()));
+            appendString(pool, *s);
+        }
+        out.insert(out.end(), pool.begin(), pool.end());
+        dataLength = static_cast<uint32_t>(pool.size());
+    }
+
+    static void buildEscr1_00(const std::vector<std::string>& strings, const std::vector<uint8_t>& bytecode, std::vector<uint8_t>& out) {
+        const char magic[] = "ESCR1_00";
+        out.insert(out.end(), magic, magic + 8);
+        append32(out, static_cast<uint32_t>(strings.size() + 1));
+
+        // 第一个字符串为空字符串
+        std::vector<uint8_t> pool(1, 0);
+        append32(out, 0);
+        for (const std::string& s : strings) {
+            append32(out, static_cast<uint32_t>(pool.size()));
+            appendString(pool, s);
+        }
+
+        append32(out, static_cast<uint32_t>(bytecode.size()));
+        out.insert(out.end(), bytecode.begin(), bytecode.end());
+        append32(out, static_cast<uint32_t>(pool.size()));
+        out.insert(out.end(), pool.begin(), pool.end());
+    }
+
+    static void buildEscudeScript(const std::vector<std::string>& strings, const std::vector<uint8_t>& bytecode, bool twoSegments,
+                                  std::vector<uint8_t>& out) {
+        const char magic[] = "@escu:de";
+        out.insert(out.end(), magic, magic + 8);
+        out.resize(0x1C);
+        out.insert(out.end(), bytecode.begin(), bytecode.end());
+
+        size_t firstCount = twoSegments ? strings.size() / 2 : strings.size();
+        uint32_t firstDataLength = 0;
+        uint32_t lastDataLength = 0;
+        appendSegment(out, strings.data(), strings.data() + firstCount, firstDataLength);
+        if (twoSegments) {
+            appendSegment(out, strings.data() + firstCount, strings.data() + strings.size(), lastDataLength);
+        } else {
+            lastDataLength = firstDataLength;
+            firstDataLength = 0;
+        }
+
+        writeLittleEndian32(out.data() + 0x08, static_cast<uint32_t>(bytecode.size()));
+        writeLittleEndian32(out.data() + 0x0C, twoSegments ? 1 : 0);
+        writeLittleEndian32(out.data() + 0x10, firstDataLength);
+        writeLittleEndian32(out.data() + 0x14, static_cast<uint32_t>(strings.size() - firstCount));
+        writeLittleEndian32(out.data() + 0x18, lastDataLength);
+    }
+
+    CorpusConfig config_;
+    std::mt19937_64 random_;
+};
+
+void writeBinaryFile(const fs::path& path, const void* data, size_t size) {
+    std::ofstream output(path, std::ios::binary);
+    output.write(static_cast<const char*>(data), size);
+    if (!output) {
+        throw std::runtime_error("Cannot write file: " + path.string());
+    }
+}
+
+// 将语料写入目录: scripts/下为脚本文件, texts/下为对应的txt文件, 每1000个文件一个子目录
+uintmax_t writeCorpus(CorpusGenerator& generator, const fs::path& dir, size_t fileCount) {
+    uintmax_t totalBytes = 0;
+    std::vector<uint8_t> script;
+    std::string text;
+    for (size_t i = 0; i < fileCount; i++) {
+        ScriptVariant variant = allVariants[i % 3];
+        generator.generate(variant, script, text);
+
+        char name[48];
+        std::snprintf(name, sizeof(name), "%02zu/%06zu", i / 1000, i);
+        fs::path scriptPath = dir / "scripts" / (std::string(name) + ".bin");
+        fs::path textPath = dir / "texts" / (std::string(name) + ".txt");
+        fs::create_directories(scriptPath.parent_path());
+        fs::create_directories(textPath.parent_path());
+        writeBinaryFile(scriptPath, script.data(), script.size());
+        writeBinaryFile(textPath, text.data(), text.size());
+        totalBytes += script.size();
+    }
+    return totalBytes;
+}
+
+// 丢弃所有输出的流缓冲区, 测量时屏蔽工具的逐文件输出
+class NullBuffer : public std::streambuf {
+protected:
+    int overflow(int c) override {
+        return c;
+    }
+    std::streamsize xsputn(const char*, std::streamsize n) override {
+        return n;
+    }
+};
+
+// 以命令行参数调用script_tool
+void runTool(const std::vector<std::string>& args) {
+    std::vector<std::string> argStorage = {"script_tool"};
+    argStorage.insert(argStorage.end(), args.begin(), args.end());
+    std::vector<char*> argv;
+    for (std::string& arg : argStorage) {
+        argv.push_back(arg.data());
+    }
+
+    ScriptToolSettings settings;
+    settings.formats = {&Escr1_00Format::instance(), &EscudeScriptFormat::instance()};
+
+    NullBuffer nullBuffer;
+    std::streambuf* saved = std::cout.rdbuf(&nullBuffer);
+    int status = ScriptTool(settings).run(static_cast<int>(argv.size()), argv.data());
+    std::cout.rdbuf(saved);
+    if (status != 0) {
+        throw std::runtime_error("script_tool " + args.front() + " failed");
+    }
+}
+
+// 一项测量的结果, 取多次运行的中位数
+struct Measurement {
+    double seconds = 0;
+    uintmax_t bytes = 0;
+    size_t files = 0;
+};
+
+Measurement measure(int iterations, uintmax_t bytes, size_t files, const std::function<void()>& body) {
+    std::vector<double> times;
+    for (int i = 0; i < iterations; i++) {
+        auto start = std::chrono::steady_clock::now();
+        body();
+        auto end = std::chrono::steady_clock::now();
+        times.push_back(std::chrono::duration<double>(end - start).count());
+    }
+    std::sort(times.begin(), times.end());
+    return {times[times.size() / 2], bytes, files};
+}
+
+void writeMeasurement(std::ostream& out, const char* name, const Measurement& m) {
+    double seconds = std::max(m.seconds, 1e-9);
+    out << "\"" << name << "\": {\"seconds\": " << m.seconds << ", \"mb_per_s\": " << (m.bytes / 1e6) / seconds
+        << ", \"files_per_s\": " << m.files / seconds << "}";
+}
+
+struct BenchOptions {
+    CorpusConfig corpus;
+    size_t batchFiles = 10000;
+    int iterations = 5;
+    int batchIterations = 1;
+    unsigned jobs = 1;
+    std::string workDir = "bench_work";
+    std::string outputFile;
+    std::string generateDir;
+};
+
+void runBenchmarks(const BenchOptions& options, std::ostream& out) {
+    fs::path work = options.workDir;
+    fs::remove_all(work);
+    fs::create_directories(work / "single");
+
+    CorpusGenerator generator(options.corpus);
+    std::string jobs = std::to_string(options.jobs);
+    out.precision(6);
+
+    out << "{\n";
+    out << "  \"config\": {\"strings\": " << options.corpus.stringCount << ", \"min_length\": " << options.corpus.minLength
+        << ", \"max_length\": " << options.corpus.maxLength << ", \"bytecode\": " << options.corpus.bytecodeSize
+        << ", \"seed\": " << options.corpus.seed << ", \"iterations\": " << options.iterations
+        << ", \"batch_files\": " << options.batchFiles << ", \"batch_iterations\": " << options.batchIterations
+        << ", \"jobs\": " << options.jobs << "},\n";
+
+    // 单文件: 每种变体分别测量
+    out << "  \"single\": [\n";
+    bool first = true;
+    for (ScriptVariant variant : allVariants) {
+        std::vector<uint8_t> script;
+        std::string text;
+        generator.generate(variant, script, text);
+
+        fs::path scriptPath = work / "single" / (std::string(variantName(variant)) + ".bin");
+        fs::path textPath = work / "single" / (std::string(variantName(variant)) + ".txt");
+        fs::path extractedPath = work / "single" / (std::string(variantName(variant)) + ".extracted.txt");
+        writeBinaryFile(scriptPath, script.data(), script.size());
+        writeBinaryFile(textPath, text.data(), text.size());
+
+        Measurement extract = measure(options.iterations, script.size(), 1, [&] {
+            runTool({"-e", scriptPath.string(), extractedPath.string()});
+        });
+        Measurement modify = measure(options.iterations, script.size(), 1, [&] {
+            runTool({"-m", scriptPath.string(), textPath.string()});
+        });
+
+        out << (first ? "" : ",\n") << "    {\"variant\": \"" << variantName(variant) << "\", \"file_bytes\": " << script.size() << ", ";
+        writeMeasurement(out, "extract", extract);
+        out << ", ";
+        writeMeasurement(out, "modify", modify);
+        out << ", ";
+        // 单文本段的@escu:de脚本提取时不输出文本, 无法往返
+        if (fs::exists(extractedPath)) {
+            Measurement roundTrip = measure(options.iterations, script.size(), 1, [&] {
+                runTool({"-e", scriptPath.string(), extractedPath.string()});
+                runTool({"-m", scriptPath.string(), extractedPath.string()});
+            });
+            writeMeasurement(out, "roundtrip", roundTrip);
+        } else {
+            out << "\"roundtrip\": null";
+        }
+        out << "}";
+        first = false;
+    }
+    out << "\n  ],\n";
+
+    // 批量: 三种变体轮流生成
+    fs::path batchDir = work / "batch";
+    uintmax_t batchBytes = writeCorpus(generator, batchDir, options.batchFiles);
+    std::string scripts = (batchDir / "scripts").string();
+    std::string texts = (batchDir / "texts").string();
+    std::string extracted = (batchDir / "extracted").string();
+
+    Measurement batchExtract = measure(options.batchIterations, batchBytes, options.batchFiles, [&] {
+        runTool({"-be", scripts, extracted, "-j", jobs});
+    });
+    Measurement batchModify = measure(options.batchIterations, batchBytes, options.batchFiles, [&] {
+        runTool({"-bm", texts, scripts, "-j", jobs});
+    });
+    Measurement batchRoundTrip = measure(options.batchIterations, batchBytes, options.batchFiles, [&] {
+        runTool({"-be", scripts, extracted, "-j", jobs});
+        runTool({"-bm", extracted, scripts, "-j", jobs});
+    });
+
+    out << "  \"batch\": {\"files\": " << options.batchFiles << ", \"bytes\": " << batchBytes << ", ";
+    writeMeasurement(out, "extract", batchExtract);
+    out << ", ";
+    writeMeasurement(out, "modify", batchModify);
+    out << ", ";
+    writeMeasurement(out, "roundtrip", batchRoundTrip);
+    out << "}\n";
+    out << "}\n";
+
+    fs::remove_all(work);
+}
+
+void printUsage() {
+    std::cout << "Usage:" << std::endl;
+    std::cout << "  Run benchmarks: bench [options]" << std::endl;
+    std::cout << "  Generate corpus only: bench --generate <directory> [options]" << std::endl;
+    std::cout << "Options:" << std::endl;
+    std::cout << "  --strings <N>          Strings per script (default 200)" << std::endl;
+    std::cout << "  --min-len <N>          Minimum string length in bytes (default 4)" << std::endl;
+    std::cout << "  --max-len <N>          Maximum string length in bytes (default 60)" << std::endl;
+    std::cout << "  --bytecode <N>         Bytecode size per script in bytes (default 4096)" << std::endl;
+    std::cout << "  --files <N>            Files in the batch corpus (default 10000)" << std::endl;
+    std::cout << "  --iterations <N>       Runs per single-file measurement, the median is reported (default 5)" << std::endl;
+    std::cout << "  --batch-iterations <N> Runs per batch measurement (default 1)" << std::endl;
+    std::cout << "  --seed <N>             Random seed (default 1)" << std::endl;
+    std::cout << "  -j <N>                 Worker threads for batch modes (0 = all cores, default 1)" << std::endl;
+    std::cout << "  --work-dir <dir>       Scratch directory, removed afterwards (default bench_work)" << std::endl;
+    std::cout << "  --output <file>        Write the JSON report to a file instead of stdout" << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+    try {
+        BenchOptions options;
+        for (int i = 1; i < argc; i++) {
+            std::string option = argv[i];
+            if (i + 1 >= argc) {
+                std::cerr << "Unknown option: " << option << std::endl;
+                printUsage();
+                return 1;
+            }
+            std::string value = argv[++i];
+            if (option == "--strings") {
+                options.corpus.stringCount = std::stoul(value);
+            } else if (option == "--min-len") {
+                options.corpus.minLength = std::stoul(value);
+            } else if (option == "--max-len") {
+                options.corpus.maxLength = std::stoul(value);
+            } else if (option == "--bytecode") {
+                options.corpus.bytecodeSize = std::stoul(value);
+            } else if (option == "--files") {
+                options.batchFiles = std::stoul(value);
+            } else if (option == "--iterations") {
+                options.iterations = std::max(1, std::stoi(value));
+            } else if (option == "--batch-iterations") {
+                options.batchIterations = std::max(1, std::stoi(value));
+            } else if (option == "--seed") {
+                options.corpus.seed = std::stoull(value);
+            } else if (option == "-j") {
+                options.jobs = parseJobCount(value);
+            } else if (option == "--work-dir") {
+                options.workDir = value;
+            } else if (option == "--output") {
+                options.outputFile = value;
+            } else if (option == "--generate") {
+                options.generateDir = value;
+            } else {
+                std::cerr << "Unknown option: " << option << std::endl;
+                printUsage();
+                return 1;
+            }
+        }
+        if (options.corpus.minLength > options.corpus.maxLength) {
+            throw std::runtime_error("--min-len must not exceed --max-len");
+        }
+
+        if (!options.generateDir.empty()) {
+            CorpusGenerator generator(options.corpus);
+            uintmax_t bytes = writeCorpus(generator, options.generateDir, options.batchFiles);
+            std::cout << "Generated " << options.batchFiles << " scripts, " << bytes << " bytes." << std::endl;
+            return 0;
+        }
+
+        if (options.outputFile.empty()) {
+            runBenchmarks(options, std::cout);
+        } else {
+            std::ofstream output(options.outputFile);
+            if (!output) {
+                throw std::runtime_error("Cannot open output file: " + options.outputFile);
+            }
+            runBenchmarks(options, output);
+        }
+        return 0;
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+}
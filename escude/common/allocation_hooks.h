@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstdlib>
+#include <new>
+
+#include "run_stats.h"
+
+// 替换全局operator new, 为运行统计记录内存分配次数
+// 替换函数不能是inline函数, 因此每个程序只能在main.cpp中包含一次
+// 未启用统计时只多一次标志检查
+
+void* operator new(std::size_t size) {
+    RunStats::countAllocation();
+    if (size == 0) size = 1;
+    while (true) {
+        void* p = std::malloc(size);
+        if (p) return p;
+        std::new_handler handler = std::get_new_handler();
+        if (!handler) throw std::bad_alloc();
+        handler();
+    }
+}
+
+void* operator new[](std::size_t size) {
+    return ::operator new(size);
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept {
+    try {
+        return ::operator new(size);
+    } catch (...) {
+        return nullptr;
+    }
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept {
+    return ::operator new(size, std::nothrow);
+}
+
+// GCC把内联后的operator new识别为内置分配函数, 会对这里的free误报不匹配
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+
+void operator delete(void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete[](void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept {
+    std::free(p);
+}
+
+void operator delete[](void* p, std::size_t) noexcept {
+    std::free(p);
+}
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
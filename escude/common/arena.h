@@ -0,0 +1,61 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+// 线性分配器
+// 从大块内存中顺序分配, 不单独释放; reset后保留已申请的内存块, 供下一个文件重复使用
+class Arena {
+public:
+    explicit Arena(size_t blockSize = 64 * 1024) : blockSize_(blockSize) {}
+
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    char* allocate(size_t size) {
+        while (current_ < blocks_.size()) {
+            Block& block = blocks_[current_];
+            if (block.size - used_ >= size) {
+                char* p = block.data.get() + used_;
+                used_ += size;
+                return p;
+            }
+            current_++;
+            used_ = 0;
+        }
+
+        // 已有的块都放不下, 申请新块; 超过块大小的请求单独占用一块
+        size_t blockSize = std::max(size, blockSize_);
+        blocks_.push_back({std::unique_ptr<char[]>(new char[blockSize]), blockSize});
+        current_ = blocks_.size() - 1;
+        used_ = size;
+        return blocks_.back().data.get();
+    }
+
+    std::string_view copy(const char* data, size_t size) {
+        char* p = allocate(size);
+        std::memcpy(p, data, size);
+        return std::string_view(p, size);
+    }
+
+    // 回到第一个块的开头, 之前分配的内存全部失效
+    void reset() {
+        current_ = 0;
+        used_ = 0;
+    }
+
+private:
+    struct Block {
+        std::unique_ptr<char[]> data;
+        size_t size;
+    };
+
+    size_t blockSize_;
+    std::vector<Block> blocks_;
+    size_t current_ = 0;
+    size_t used_ = 0;
+};
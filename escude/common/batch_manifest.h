@@ -0,0 +1,102 @@
+#pragma once
+
+#include <cinttypes>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+
+// 增量批量修改使用的清单文件
+// 每行记录一个已完成的文件: txt文件哈希, 修改后bin文件哈希, bin文件相对路径
+// 每个文件处理完成后立即追加一行, 批量处理中断后再次运行时可以从清单继续;
+// 同一路径出现多次时以最后一行为准, 处理结束后重写为每个路径一行
+class BatchManifest {
+public:
+    struct Entry {
+        uint64_t textHash;
+        uint64_t scriptHash;
+    };
+
+    ~BatchManifest() {
+        if (journal_) {
+            std::fclose(journal_);
+        }
+    }
+
+    void open(const std::string& path) {
+        path_ = path;
+        entries_.clear();
+
+        std::ifstream input(path);
+        std::string line;
+        while (std::getline(input, line)) {
+            std::istringstream fields(line);
+            std::string textHash, scriptHash, key;
+            if (!(fields >> textHash >> scriptHash) || !std::getline(fields >> std::ws, key) || key.empty()) {
+                // 中断时可能留下不完整的最后一行, 直接忽略
+                continue;
+            }
+            try {
+                entries_[key] = {std::stoull(textHash, nullptr, 16), std::stoull(scriptHash, nullptr, 16)};
+            } catch (const std::exception&) {
+                continue;
+            }
+        }
+        input.close();
+
+        journal_ = std::fopen(path.c_str(), "a");
+        if (!journal_) {
+            throw std::runtime_error("Cannot open manifest file: " + path);
+        }
+    }
+
+    // 判断文件是否与上次处理完成时相同, 只在处理开始前调用, 不需要加锁
+    bool isUnchanged(const std::string& key, uint64_t textHash, uint64_t scriptHash) const {
+        auto it = entries_.find(key);
+        return it != entries_.end() && it->second.textHash == textHash && it->second.scriptHash == scriptHash;
+    }
+
+    // 记录一个处理完成的文件, 可以在多个线程中调用
+    void record(const std::string& key, uint64_t textHash, uint64_t scriptHash) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        completed_[key] = {textHash, scriptHash};
+        std::fprintf(journal_, "%016" PRIx64 " %016" PRIx64 " %s\n", textHash, scriptHash, key.c_str());
+        std::fflush(journal_);
+    }
+
+    // 重写清单, 合并本次和以前的记录
+    void compact() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (const auto& item : completed_) {
+            entries_[item.first] = item.second;
+        }
+
+        std::string tempPath = path_ + ".tmp";
+        FILE* output = std::fopen(tempPath.c_str(), "w");
+        if (!output) {
+            throw std::runtime_error("Cannot write manifest file: " + path_);
+        }
+        for (const auto& item : entries_) {
+            std::fprintf(output, "%016" PRIx64 " %016" PRIx64 " %s\n", item.second.textHash, item.second.scriptHash, item.first.c_str());
+        }
+        bool ok = std::fclose(output) == 0;
+
+        std::fclose(journal_);
+        journal_ = nullptr;
+        if (!ok || std::rename(tempPath.c_str(), path_.c_str()) != 0) {
+            std::remove(tempPath.c_str());
+            throw std::runtime_error("Cannot write manifest file: " + path_);
+        }
+    }
+
+private:
+    std::string path_;
+    std::unordered_map<std::string, Entry> entries_;
+    std::unordered_map<std::string, Entry> completed_;
+    std::mutex mutex_;
+    FILE* journal_ = nullptr;
+};
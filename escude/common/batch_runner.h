@@ -0,0 +1,220 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <iostream>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "run_stats.h"
+
+// 单个文件的处理结果, 每个任务只写自己的槽位, 不需要加锁
+struct BatchResult {
+    bool success = false;
+    bool skipped = false; // 不属于本工具处理的文件, 不计入处理数量和错误数量
+    std::string output; // 输出到stdout的内容
+    std::string error;  // 输出到stderr的内容
+};
+
+struct BatchSummary {
+    int processedCount = 0;
+    int errorCount = 0;
+    int skippedCount = 0;
+};
+
+using BatchTaskFn = std::function<void(size_t index, BatchResult& result)>;
+
+// 工作窃取线程池
+// 任务按权重(文件大小)从大到小轮流分配到各线程的队列, 线程从自己队列的头部取最大的任务,
+// 自己的队列为空时从其他线程队列的尾部窃取
+class WorkStealingPool {
+public:
+    explicit WorkStealingPool(unsigned workerCount) : queues_(std::max(1u, workerCount)) {}
+
+    void run(const std::vector<uintmax_t>& weights, const std::function<void(size_t)>& task) {
+        std::vector<size_t> order(weights.size());
+        for (size_t i = 0; i < order.size(); i++) {
+            order[i] = i;
+        }
+        std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+            return weights[a] > weights[b];
+        });
+
+        for (size_t i = 0; i < order.size(); i++) {
+            queues_[i % queues_.size()].tasks.push_back(order[i]);
+        }
+
+        std::vector<std::thread> threads;
+        for (size_t w = 1; w < queues_.size(); w++) {
+            threads.emplace_back([this, w, &task] { workerLoop(w, task); });
+        }
+        workerLoop(0, task);
+        for (auto& t : threads) {
+            t.join();
+        }
+    }
+
+private:
+    struct Queue {
+        std::mutex mutex;
+        std::deque<size_t> tasks;
+    };
+
+    bool popOwn(size_t worker, size_t& index) {
+        Queue& q = queues_[worker];
+        std::lock_guard<std::mutex> lock(q.mutex);
+        if (q.tasks.empty()) return false;
+        index = q.tasks.front();
+        q.tasks.pop_front();
+        return true;
+    }
+
+    bool steal(size_t worker, size_t& index) {
+        for (size_t i = 1; i < queues_.size(); i++) {
+            Queue& q = queues_[(worker + i) % queues_.size()];
+            std::lock_guard<std::mutex> lock(q.mutex);
+            if (q.tasks.empty()) continue;
+            index = q.tasks.back();
+            q.tasks.pop_back();
+            return true;
+        }
+        return false;
+    }
+
+    void workerLoop(size_t worker, const std::function<void(size_t)>& task) {
+        size_t index;
+        // 任务在开始前已全部入队, 所有队列为空即可退出
+        while (popOwn(worker, index) || steal(worker, index)) {
+            task(index);
+        }
+    }
+
+    std::vector<Queue> queues_;
+};
+
+// 批处理的内存预算
+// 每个任务开始前按估计的内存占用申请预算, 正在处理的任务的占用之和不超过上限, 超过时工作线程等待已有的任务完成;
+// 按申请的顺序接收, 大任务不会被后来的小任务一直推迟; 单个任务超过上限时等待其他任务全部完成后单独执行
+class MemoryBudget {
+public:
+    // limit为0时不限制
+    explicit MemoryBudget(uint64_t limit) : limit_(limit) {}
+
+    void acquire(uint64_t bytes) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        uint64_t ticket = nextTicket_++;
+        condition_.wait(lock, [&] {
+            return ticket == serving_ && (limit_ == 0 || inUse_ == 0 || inUse_ + bytes <= limit_);
+        });
+        serving_++;
+        inUse_ += bytes;
+        RunStats::noteInFlightBytes(inUse_);
+        // 下一个申请者可能也在预算之内
+        condition_.notify_all();
+    }
+
+    void release(uint64_t bytes) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            inUse_ -= bytes;
+        }
+        condition_.notify_all();
+    }
+
+private:
+    uint64_t limit_;
+    uint64_t inUse_ = 0;
+    uint64_t nextTicket_ = 0;
+    uint64_t serving_ = 0;
+    std::mutex mutex_;
+    std::condition_variable condition_;
+};
+
+// 作用域内占用预算
+class MemoryGrant {
+public:
+    MemoryGrant(MemoryBudget& budget, uint64_t bytes) : budget_(budget), bytes_(bytes) {
+        budget_.acquire(bytes_);
+    }
+    ~MemoryGrant() {
+        budget_.release(bytes_);
+    }
+    MemoryGrant(const MemoryGrant&) = delete;
+    MemoryGrant& operator=(const MemoryGrant&) = delete;
+
+private:
+    MemoryBudget& budget_;
+    uint64_t bytes_;
+};
+
+// 解析 -j 参数, 0 表示使用全部CPU核心
+inline unsigned parseJobCount(const std::string& value) {
+    unsigned long jobs = 0;
+    try {
+        jobs = std::stoul(value);
+    } catch (const std::exception&) {
+        throw std::runtime_error("Invalid job count: " + value);
+    }
+    if (jobs == 0) {
+        jobs = std::max(1u, std::thread::hardware_concurrency());
+    }
+    return static_cast<unsigned>(jobs);
+}
+
+inline void printBatchResult(const BatchResult& result, BatchSummary& summary) {
+    std::cout << result.output;
+    std::cerr << result.error;
+    if (result.skipped) {
+        summary.skippedCount++;
+    } else if (result.success) {
+        summary.processedCount++;
+    } else {
+        summary.errorCount++;
+    }
+}
+
+// 执行批量任务, 结果按任务顺序输出, 统计结果与串行模式一致
+// jobs <= 1 时在当前线程按顺序执行, 每个任务完成后立即输出
+// 并行时每个任务按权重占用memoryBudget(字节, 0为不限制), 见MemoryBudget
+inline BatchSummary runBatch(const std::vector<uintmax_t>& weights, unsigned jobs, uint64_t memoryBudget, const BatchTaskFn& task) {
+    BatchSummary summary;
+    auto runOne = [&task](size_t index, BatchResult& result) {
+        try {
+            task(index, result);
+        } catch (const std::exception& e) {
+            result.success = false;
+            result.error += e.what();
+            result.error += '\n';
+        }
+    };
+
+    if (jobs <= 1 || weights.size() <= 1) {
+        for (size_t i = 0; i < weights.size(); i++) {
+            BatchResult result;
+            RunStats::noteInFlightBytes(weights[i]);
+            runOne(i, result);
+            printBatchResult(result, summary);
+        }
+        return summary;
+    }
+
+    std::vector<BatchResult> results(weights.size());
+    MemoryBudget budget(memoryBudget);
+    WorkStealingPool pool(std::min<size_t>(jobs, weights.size()));
+    pool.run(weights, [&](size_t index) {
+        MemoryGrant grant(budget, weights[index]);
+        runOne(index, results[index]);
+    });
+
+    for (const auto& result : results) {
+        printBatchResult(result, summary);
+    }
+    return summary;
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstdint>
+
+// 读取小端序 uint32_t
+inline uint32_t readLittleEndian32(const uint8_t* data) {
+    return data[0] | (data[1] << 8) | (data[2] << 16) | (static_cast<uint32_t>(data[3]) << 24);
+}
+
+// 写入小端序 uint32_t
+inline void writeLittleEndian32(uint8_t* data, uint32_t value) {
+    data[0] = value & 0xFF;
+    data[1] = (value >> 8) & 0xFF;
+    data[2] = (value >> 16) & 0xFF;
+    data[3] = (value >> 24) & 0xFF;
+}
+
+// 读取小端序 uint64_t
+inline uint64_t readLittleEndian64(const uint8_t* data) {
+    return readLittleEndian32(data) | (static_cast<uint64_t>(readLittleEndian32(data + 4)) << 32);
+}
+
+// 写入小端序 uint64_t
+inline void writeLittleEndian64(uint8_t* data, uint64_t value) {
+    writeLittleEndian32(data, static_cast<uint32_t>(value));
+    writeLittleEndian32(data + 4, static_cast<uint32_t>(value >> 32));
+}
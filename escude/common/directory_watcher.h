@@ -0,0 +1,103 @@
+#pragma once
+
+#include <cerrno>
+#include <climits>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <sys/inotify.h>
+#include <unistd.h>
+
+// 使用inotify监视目录树中文件的写入
+// 可以同时监视多个目录树, 事件报告为(目录树编号, 相对路径); 新建的子目录自动加入监视
+class DirectoryWatcher {
+public:
+    // 事件回调, 参数为(目录树编号, 相对于该目录树的路径)
+    using Callback = std::function<void(int tree, const std::string& path)>;
+
+    DirectoryWatcher() = default;
+    DirectoryWatcher(const DirectoryWatcher&) = delete;
+    DirectoryWatcher& operator=(const DirectoryWatcher&) = delete;
+
+    ~DirectoryWatcher() {
+        if (fd_ >= 0) ::close(fd_);
+    }
+
+    bool open() {
+        fd_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        return fd_ >= 0;
+    }
+
+    int fd() const { return fd_; }
+
+    // 监视root及其所有子目录, 返回目录树编号
+    int addTree(const std::string& root) {
+        int tree = static_cast<int>(roots_.size());
+        roots_.push_back(root);
+        addDirectory(tree, std::filesystem::path());
+        return tree;
+    }
+
+    // 读取所有已到达的事件, 文件写入完成或移入时调用callback; 返回false表示事件队列溢出, 可能遗漏了事件
+    bool readEvents(const Callback& callback) {
+        bool complete = true;
+        alignas(struct inotify_event) char buffer[64 * 1024];
+        while (true) {
+            ssize_t length = ::read(fd_, buffer, sizeof(buffer));
+            if (length <= 0) {
+                if (length < 0 && errno == EINTR) continue;
+                break;
+            }
+            for (char* p = buffer; p < buffer + length;) {
+                const struct inotify_event* event = reinterpret_cast<const struct inotify_event*>(p);
+                p += sizeof(struct inotify_event) + event->len;
+                if (event->mask & IN_Q_OVERFLOW) {
+                    complete = false;
+                    continue;
+                }
+                auto it = directories_.find(event->wd);
+                if (it == directories_.end() || event->len == 0) continue;
+
+                const Directory& directory = it->second;
+                std::filesystem::path path = directory.path / event->name;
+                if (event->mask & IN_ISDIR) {
+                    if (event->mask & (IN_CREATE | IN_MOVED_TO)) {
+                        addDirectory(directory.tree, path);
+                    }
+                } else if (event->mask & (IN_CLOSE_WRITE | IN_MOVED_TO)) {
+                    callback(directory.tree, path.generic_string());
+                }
+            }
+        }
+        return complete;
+    }
+
+private:
+    struct Directory {
+        int tree;
+        std::filesystem::path path; // 相对于目录树的根
+    };
+
+    void addDirectory(int tree, const std::filesystem::path& relativePath) {
+        namespace fs = std::filesystem;
+        fs::path fullPath = fs::path(roots_[tree]) / relativePath;
+        int wd = inotify_add_watch(fd_, fullPath.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE | IN_ONLYDIR);
+        if (wd < 0) return;
+        directories_[wd] = {tree, relativePath};
+
+        std::error_code error;
+        for (fs::directory_iterator it(fullPath, error), end; !error && it != end; it.increment(error)) {
+            if (it->is_directory(error)) {
+                addDirectory(tree, relativePath / it->path().filename());
+            }
+        }
+    }
+
+    int fd_ = -1;
+    std::vector<std::string> roots_;
+    std::unordered_map<int, Directory> directories_;
+};
@@ -0,0 +1,141 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "byte_order.h"
+#include "file_writer.h"
+#include "run_stats.h"
+#include "script_format.h"
+#include "script_layout.h"
+#include "script_view.h"
+#include "string_pool.h"
+#include "text_codec.h"
+
+// ESCR1_00格式脚本
+// 结构: 文件头"ESCR1_00", 字符串数量, 字符串偏移表, 字节码长度, 字节码, 文本段长度, 文本段
+// 第一个字符串固定为空字符串, 提取时跳过; txt文件使用\r\n换行
+class Escr1_00Format : public ScriptFormat {
+public:
+    static const Escr1_00Format& instance() {
+        static const Escr1_00Format format;
+        return format;
+    }
+
+    const char* name() const override {
+        return "ESCR1_00";
+    }
+
+    // 检查文件头是否符合ESCR1_00标识
+    bool matches(const uint8_t* data, size_t size) const override {
+        return Escr1_00View::matches(data, size);
+    }
+
+    bool extractText(const uint8_t* data, size_t fileSize, std::string& output, const TextConversion& conversion) const override {
+        Escr1_00View view(data, fileSize);
+        RunStats::addStrings(appendTextLines<Layout>(view.segment(), output, conversion));
+        return true;
+    }
+
+    bool forEachString(const uint8_t* data, size_t fileSize, const StringVisitor& visit) const override {
+        Escr1_00View view(data, fileSize);
+        for (std::string_view text : view.segment()) {
+            visit(0, text);
+        }
+        return true;
+    }
+
+    // 检查原文件结构和文本数量后, 按是否合并字符串选择重建的实现
+    void buildModifiedScript(const uint8_t* data, size_t fileSize, const std::vector<std::string_view>& newTexts,
+                             const BuildOptions& options, ScriptImage& image, std::ostream&) const override {
+        // 验证文件头
+        if (!matches(data, fileSize) || fileSize < Layout::indexTable) {
+            throw std::runtime_error("Invalid ESCR1_00 file format");
+        }
+
+        // 解析原始文件结构
+        uint32_t str_count = readLittleEndian32(data + Layout::countField);
+        size_t index_table_size = static_cast<size_t>(str_count) * 4;
+        if (fileSize < Layout::indexTable + index_table_size + 4) {
+            throw std::runtime_error("Invalid file structure");
+        }
+        uint32_t script_size = readLittleEndian32(data + Layout::indexTable + index_table_size);
+        if (fileSize < Layout::indexTable + index_table_size + 4 + script_size) {
+            throw std::runtime_error("Invalid file structure");
+        }
+
+        // 检查文本数量是否匹配（减去第一个空字符串）
+        if (newTexts.size() != str_count - 1) {
+            throw std::runtime_error("Text count mismatch. Expected: " + std::to_string(str_count - 1) +
+                                    ", Got: " + std::to_string(newTexts.size()));
+        }
+
+        if (options.poolStrings) {
+            build<true>(data, str_count, script_size, newTexts, image);
+        } else {
+            build<false>(data, str_count, script_size, newTexts, image);
+        }
+    }
+
+    // 文件头和字符串数量, 字节码长度和字节码; 索引表和文本段属于文本
+    std::vector<ByteRange> fixedRanges(const uint8_t* data, size_t fileSize) const override {
+        Escr1_00View view(data, fileSize);
+        size_t scriptPos = view.scriptPos() - 4; // 包括字节码长度
+        return {{0, Layout::indexTable}, {scriptPos, view.textSegmentPos() - 4 - scriptPos}};
+    }
+
+    bool stripsCarriageReturn() const override {
+        return true;
+    }
+
+private:
+    using Layout = Escr1_00Layout;
+
+    // 新文件由三部分组成: 文件头和索引表, 原脚本字节码, 文本段
+    template <bool Pooled>
+    static void build(const uint8_t* data, uint32_t str_count, uint32_t script_size,
+                      const std::vector<std::string_view>& newTexts, ScriptImage& image) {
+        // 预先计算新文件各部分的准确大小
+        thread_local StringPool pool;
+        size_t textSegmentSize = Layout::reservedStrings; // 第一个字符串是空字符串
+        textSegmentSize += SegmentWriter<Pooled>::measure(newTexts.data(), newTexts.size(), pool);
+        if (textSegmentSize > UINT32_MAX) {
+            throw std::runtime_error("Text segment too large");
+        }
+
+        size_t index_table_size = static_cast<size_t>(str_count) * 4;
+        size_t headSize = Layout::indexTable + index_table_size + 4;
+        size_t tailSize = 4 + textSegmentSize;
+        image.buffer.resize(headSize + tailSize);
+        uint8_t* head = image.buffer.data();
+        uint8_t* tail = head + headSize;
+
+        // 写入文件头和字符串数量
+        std::memcpy(head, Layout::magic, 8);
+        writeLittleEndian32(head + Layout::countField, str_count);
+
+        // 写入脚本大小
+        writeLittleEndian32(head + Layout::indexTable + index_table_size, script_size);
+
+        // 写入文本段大小
+        writeLittleEndian32(tail, static_cast<uint32_t>(textSegmentSize));
+
+        // 第一个字符串为空字符串, 其余字符串的索引表和数据区域紧随其后
+        uint8_t* offsets = head + Layout::indexTable;
+        uint8_t* textPool = tail + 4;
+        writeLittleEndian32(offsets, 0);
+        textPool[0] = 0;
+        SegmentWriter<Pooled>::write(offsets + Layout::reservedStrings * 4, textPool + Layout::reservedStrings,
+                                     Layout::reservedStrings, newTexts.data(), newTexts.size(), pool);
+
+        // 字节码不做复制, image直接引用原数据
+        image.parts[0] = {head, headSize};
+        image.parts[1] = {const_cast<uint8_t*>(data + headSize), script_size};
+        image.parts[2] = {tail, tailSize};
+        image.partCount = 3;
+    }
+};
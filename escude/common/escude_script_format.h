@@ -0,0 +1,155 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "byte_order.h"
+#include "file_writer.h"
+#include "run_stats.h"
+#include "script_format.h"
+#include "script_layout.h"
+#include "script_view.h"
+#include "string_pool.h"
+#include "text_codec.h"
+
+// @escu:de格式脚本
+// 文件头0x1C字节: 标识, 控制部分长度, 是否有两个文本段, 第一个文本段数据长度, 最后一个文本段字符串数量和数据长度
+// 控制部分之后是文本段, 每个文本段由索引表和数据区域组成; txt文件使用\n换行
+class EscudeScriptFormat : public ScriptFormat {
+public:
+    static const EscudeScriptFormat& instance() {
+        static const EscudeScriptFormat format;
+        return format;
+    }
+
+    const char* name() const override {
+        return "@escu:de";
+    }
+
+    // 检查文件头是否符合escude标识
+    bool matches(const uint8_t* data, size_t size) const override {
+        return EscudeScriptView::matches(data, size);
+    }
+
+    bool extractText(const uint8_t* data, size_t dataSize, std::string& output, const TextConversion& conversion) const override {
+        // 验证文件头, 检查是否为两个文本段
+        EscudeScriptView view(data, dataSize);
+        if (!readLittleEndian32(data + EscudeScriptHeader::segmentsField)) {
+            return false;
+        }
+
+        // 输出所有非空字符串
+        uint64_t lineCount = 0;
+        for (size_t s = 0; s < view.segmentCount(); ++s) {
+            lineCount += appendTextLines<EscudeScriptHeader>(view.segment(s), output, conversion);
+        }
+
+        RunStats::addStrings(lineCount);
+        return true;
+    }
+
+    bool forEachString(const uint8_t* data, size_t dataSize, const StringVisitor& visit) const override {
+        EscudeScriptView view(data, dataSize);
+        if (!readLittleEndian32(data + EscudeScriptHeader::segmentsField)) {
+            return false;
+        }
+        for (size_t s = 0; s < view.segmentCount(); ++s) {
+            for (std::string_view text : view.segment(s)) {
+                visit(static_cast<uint32_t>(s), text);
+            }
+        }
+        return true;
+    }
+
+    // 检查文本数量后, 按文本段数量和是否合并字符串选择重建的实现
+    void buildModifiedScript(const uint8_t* data, size_t dataSize, const std::vector<std::string_view>& newTexts,
+                             const BuildOptions& options, ScriptImage& image, std::ostream& log) const override {
+        // 验证文件头
+        EscudeScriptView view(data, dataSize);
+
+        // 检查文本行数是否与索引表匹配; 重建时只需要各文本段的字符串数量, 不读取原索引表的内容
+        uint32_t totalStringCount = view.stringCount();
+        if (newTexts.size() != totalStringCount) {
+            log << "New Texts Size: " << newTexts.size() << std::endl;
+            log << "Total String Count: " << totalStringCount << std::endl;
+            throw std::runtime_error("Mismatch between number of text lines and index table entries");
+        }
+
+        if (view.segmentCount() == 2) {
+            dispatchBuild<EscudeScriptLayout<2>>(data, view, newTexts, options, image);
+        } else {
+            dispatchBuild<EscudeScriptLayout<1>>(data, view, newTexts, options, image);
+        }
+    }
+
+    // 文件头中除文本长度以外的字段, 控制部分; 文本长度字段和文本段属于文本
+    std::vector<ByteRange> fixedRanges(const uint8_t* data, size_t dataSize) const override {
+        EscudeScriptView view(data, dataSize);
+        using Layout = EscudeScriptLayout<2>;
+        return {{0, Layout::dataLengthFields[0]}, {Layout::lastCountField, 4}, {Layout::headerSize, view.controlLength()}};
+    }
+
+    bool stripsCarriageReturn() const override {
+        return false;
+    }
+
+private:
+    template <typename Layout>
+    static void dispatchBuild(const uint8_t* data, const EscudeScriptView& view, const std::vector<std::string_view>& newTexts,
+                              const BuildOptions& options, ScriptImage& image) {
+        if (options.poolStrings) {
+            build<Layout, true>(data, view, newTexts, image);
+        } else {
+            build<Layout, false>(data, view, newTexts, image);
+        }
+    }
+
+    // 新文件由三部分组成: 文件头, 原控制部分, 新文本段; 文本段依次排列, 每个文本段为索引表和数据区域
+    template <typename Layout, bool Pooled>
+    static void build(const uint8_t* data, const EscudeScriptView& view, const std::vector<std::string_view>& newTexts,
+                      ScriptImage& image) {
+        constexpr size_t segmentCount = Layout::segmentCount;
+
+        // 预先计算新文件的准确大小, 合并字符串时每个文本段使用各自的字符串池
+        thread_local StringPool pools[2];
+        const std::string_view* texts[segmentCount];
+        size_t counts[segmentCount];
+        size_t dataLengths[segmentCount];
+        size_t textSectionSize = newTexts.size() * 4;
+        const std::string_view* next = newTexts.data();
+        for (size_t s = 0; s < segmentCount; ++s) {
+            texts[s] = next;
+            counts[s] = view.indexCount(s);
+            next += counts[s];
+            dataLengths[s] = SegmentWriter<Pooled>::measure(texts[s], counts[s], pools[s]);
+            if (dataLengths[s] > UINT32_MAX) {
+                throw std::runtime_error("Text segment too large");
+            }
+            textSectionSize += dataLengths[s];
+        }
+
+        image.buffer.resize(Layout::headerSize + textSectionSize);
+        uint8_t* header = image.buffer.data();
+        uint8_t* textSection = header + Layout::headerSize;
+
+        // 保留原始文件头, 更新各文本段的数据区域长度
+        std::memcpy(header, data, Layout::headerSize);
+        uint8_t* segmentPos = textSection;
+        for (size_t s = 0; s < segmentCount; ++s) {
+            uint8_t* pool = segmentPos + counts[s] * 4;
+            SegmentWriter<Pooled>::write(segmentPos, pool, 0, texts[s], counts[s], pools[s]);
+            segmentPos = pool + dataLengths[s];
+            writeLittleEndian32(header + Layout::dataLengthFields[s], static_cast<uint32_t>(dataLengths[s]));
+        }
+
+        // 控制部分不做复制, image直接引用原数据
+        image.parts[0] = {header, Layout::headerSize};
+        image.parts[1] = {const_cast<uint8_t*>(data + Layout::headerSize), view.controlLength()};
+        image.parts[2] = {textSection, textSectionSize};
+        image.partCount = 3;
+    }
+};
@@ -0,0 +1,268 @@
+#pragma once
+
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <limits.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include "run_stats.h"
+#include "xxhash64.h"
+
+// 带缓冲的文件输出, 用于提取文本等逐行写出的场景
+class BufferedSink {
+public:
+    static constexpr size_t bufferSize = 64 * 1024;
+
+    BufferedSink() = default;
+    BufferedSink(const BufferedSink&) = delete;
+    BufferedSink& operator=(const BufferedSink&) = delete;
+
+    ~BufferedSink() {
+        if (fd_ >= 0) {
+            try {
+                close();
+            } catch (...) {
+            }
+        }
+    }
+
+    // 创建(或截断)输出文件, 失败时返回false
+    bool open(const std::string& path) {
+        fd_ = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd_ < 0) return false;
+        path_ = path;
+        used_ = 0;
+        return true;
+    }
+
+    void write(const void* data, size_t size) {
+        const uint8_t* src = static_cast<const uint8_t*>(data);
+        if (used_ + size > bufferSize) {
+            flush();
+            // 大块数据直接写出, 不经过缓冲区
+            if (size >= bufferSize) {
+                writeFully(src, size);
+                return;
+            }
+        }
+        std::memcpy(buffer_ + used_, src, size);
+        used_ += size;
+    }
+
+    void put(char c) {
+        if (used_ == bufferSize) flush();
+        buffer_[used_++] = static_cast<uint8_t>(c);
+    }
+
+    void flush() {
+        if (used_ > 0) {
+            writeFully(buffer_, used_);
+            used_ = 0;
+        }
+    }
+
+    void close() {
+        if (fd_ < 0) return;
+        flush();
+        ::close(fd_);
+        fd_ = -1;
+    }
+
+private:
+    void writeFully(const uint8_t* data, size_t size) {
+        PhaseTimer timer(StatPhase::Write);
+        RunStats::addBytesOut(size);
+        while (size > 0) {
+            ssize_t n = ::write(fd_, data, size);
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                throw std::runtime_error("Write failed: " + path_);
+            }
+            data += n;
+            size -= static_cast<size_t>(n);
+        }
+    }
+
+    int fd_ = -1;
+    std::string path_;
+    size_t used_ = 0;
+    uint8_t buffer_[bufferSize];
+};
+
+// 将多个内存块完整写出, 处理部分写入, iov数组会被修改
+inline bool writevFully(int fd, struct iovec* iov, int count) {
+    PhaseTimer timer(StatPhase::Write);
+    while (count > 0) {
+        ssize_t n = ::writev(fd, iov, std::min(count, IOV_MAX));
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        // 跳过已完整写出的块
+        size_t written = static_cast<size_t>(n);
+        RunStats::addBytesOut(written);
+        while (count > 0 && written >= iov->iov_len) {
+            written -= iov->iov_len;
+            iov++;
+            count--;
+        }
+        if (count > 0) {
+            iov->iov_base = static_cast<uint8_t*>(iov->iov_base) + written;
+            iov->iov_len -= written;
+        }
+    }
+    return true;
+}
+
+// 创建(或截断)文件并写出全部内容
+inline bool writeFileContents(const std::string& path, const void* data, size_t size) {
+    PhaseTimer timer(StatPhase::Write);
+    int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) return false;
+
+    struct iovec iov = {const_cast<void*>(data), size};
+    bool ok = writevFully(fd, &iov, 1);
+    if (::close(fd) != 0) ok = false;
+    return ok;
+}
+
+// 在指定位置完整写出一块数据
+inline bool pwriteFully(int fd, const void* data, size_t size, off_t offset) {
+    PhaseTimer timer(StatPhase::Write);
+    RunStats::addBytesOut(size);
+    const uint8_t* src = static_cast<const uint8_t*>(data);
+    while (size > 0) {
+        ssize_t n = ::pwrite(fd, src, size, offset);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        src += n;
+        size -= static_cast<size_t>(n);
+        offset += n;
+    }
+    return true;
+}
+
+// 使用writev将多个不连续的内存块一次写入文件
+// 先写入同目录下的临时文件再重命名覆盖目标文件, 因此源数据可以直接来自目标文件的映射
+inline bool writeFileGather(const std::string& path, struct iovec* iov, int count) {
+    PhaseTimer timer(StatPhase::Write);
+    std::string tempPath = path + ".tmp";
+    int fd = ::open(tempPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) return false;
+
+    bool ok = writevFully(fd, iov, count);
+    if (::close(fd) != 0) ok = false;
+    if (!ok || std::rename(tempPath.c_str(), path.c_str()) != 0) {
+        std::remove(tempPath.c_str());
+        return false;
+    }
+    return true;
+}
+
+// 修改后的脚本文件内容
+// 新生成的数据(文件头, 索引表, 文本段)保存在buffer中, 未修改的字节码部分直接引用源数据
+struct ScriptImage {
+    std::vector<uint8_t> buffer;
+    struct iovec parts[3];
+    int partCount = 0;
+
+    ScriptImage() = default;
+    ScriptImage(const ScriptImage&) = delete;
+    ScriptImage& operator=(const ScriptImage&) = delete;
+
+    size_t size() const {
+        size_t total = 0;
+        for (int i = 0; i < partCount; i++) {
+            total += parts[i].iov_len;
+        }
+        return total;
+    }
+
+    // 判断内容是否与原数据完全相同
+    bool equals(const uint8_t* data, size_t size) const {
+        if (this->size() != size) return false;
+        for (int i = 0; i < partCount; i++) {
+            if (std::memcmp(parts[i].iov_base, data, parts[i].iov_len) != 0) return false;
+            data += parts[i].iov_len;
+        }
+        return true;
+    }
+
+    uint64_t hash() const {
+        XXHash64 hasher;
+        for (int i = 0; i < partCount; i++) {
+            hasher.update(parts[i].iov_base, parts[i].iov_len);
+        }
+        return hasher.digest();
+    }
+
+    bool writeTo(const std::string& path) const {
+        struct iovec iov[3];
+        std::copy(parts, parts + partCount, iov);
+        return writeFileGather(path, iov, partCount);
+    }
+
+    // 判断能否直接修改原文件: 所有引用原数据的部分必须仍在原来的位置
+    bool canPatchInPlace(const uint8_t* original) const {
+        size_t offset = 0;
+        for (int i = 0; i < partCount; i++) {
+            if (!ownsPart(i) && parts[i].iov_base != original + offset) return false;
+            offset += parts[i].iov_len;
+        }
+        return true;
+    }
+
+    // 直接修改原文件: 引用原数据的部分不写, 新生成的部分只写出与原文件不同的范围, 最后调整文件长度
+    // original为原文件内容(通常是它的映射), 调用前应先用canPatchInPlace检查
+    // 与writeTo不同, 写入过程中断时文件内容不完整
+    bool patchInPlace(const std::string& path, const uint8_t* original, size_t originalSize) const {
+        PhaseTimer timer(StatPhase::Write);
+        int fd = ::open(path.c_str(), O_WRONLY);
+        if (fd < 0) return false;
+
+        bool ok = true;
+        size_t offset = 0;
+        for (int i = 0; i < partCount && ok; i++) {
+            const uint8_t* data = static_cast<const uint8_t*>(parts[i].iov_base);
+            size_t length = parts[i].iov_len;
+            if (ownsPart(i)) {
+                // 跳过开头和结尾与原文件相同的字节, 超出原文件长度的部分总是写出
+                size_t overlap = offset < originalSize ? std::min(length, originalSize - offset) : 0;
+                const uint8_t* old = original + offset;
+                size_t begin = std::mismatch(data, data + overlap, old).first - data;
+                size_t end = length;
+                if (length == overlap) {
+                    while (end > begin && data[end - 1] == old[end - 1]) end--;
+                }
+                if (end > begin) {
+                    ok = pwriteFully(fd, data + begin, end - begin, static_cast<off_t>(offset + begin));
+                }
+            }
+            offset += length;
+        }
+        if (ok && offset != originalSize && ::ftruncate(fd, static_cast<off_t>(offset)) != 0) {
+            ok = false;
+        }
+        if (::close(fd) != 0) ok = false;
+        return ok;
+    }
+
+private:
+    // 该部分是否为buffer中新生成的数据
+    bool ownsPart(int i) const {
+        const uint8_t* base = static_cast<const uint8_t*>(parts[i].iov_base);
+        return base >= buffer.data() && base + parts[i].iov_len <= buffer.data() + buffer.size();
+    }
+};
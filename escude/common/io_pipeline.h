@@ -0,0 +1,607 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/eventfd.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include "batch_runner.h"
+#include "file_writer.h"
+#include "io_uring.h"
+#include "mapped_file.h"
+#include "run_stats.h"
+
+// 批处理流水线
+// 每个任务读入若干文件, 在工作线程中处理, 生成一个需要写出的文件; 读写由执行器负责, 任务只处理内存中的数据
+// 阻塞执行器在工作线程中映射输入文件并同步写出; io_uring执行器由调用线程驱动所有读写,
+// 同时有多个文件的打开, 读取和写出在进行, 与工作线程中的解析和重建重叠
+
+// 任务的一个输入文件
+struct PipelineInput {
+    std::string path;
+    int error = 0; // 打开或读取失败时非0
+    uint8_t* data = nullptr; // 进程私有的内存, 任务可以原地修改(例如解密), 不影响文件
+    size_t size = 0;
+
+    MappedFile mapped;                 // 阻塞执行器, 写时复制映射
+    std::unique_ptr<uint8_t[]> buffer; // io_uring执行器
+};
+
+// 任务需要写出的文件
+// 对象在任务之间重复使用, 缓冲区保留已申请的内存
+struct PipelineOutput {
+    std::string path;                // 为空时没有需要写出的文件
+    std::vector<struct iovec> parts; // 可以引用输入文件和下面的缓冲区
+    bool replace = false;            // 先写入临时文件再重命名覆盖, 用于修改输入文件本身
+    std::string text;
+    ScriptImage image;
+    std::string successLog;          // 写出成功后追加到标准输出
+    std::string failure;             // 写出失败时的错误信息
+    std::function<void()> onWritten; // 写出成功后调用(io_uring执行器中在调用线程中调用)
+
+    void reset() {
+        path.clear();
+        parts.clear();
+        replace = false;
+        text.clear();
+        successLog.clear();
+        failure.clear();
+        onWritten = nullptr;
+    }
+
+    // 释放超过limit字节的缓冲区, 处理过大文件后不让每个线程一直保留同样大小的内存
+    void trim(size_t limit) {
+        if (text.capacity() > limit) std::string().swap(text);
+        if (image.buffer.capacity() > limit) std::vector<uint8_t>().swap(image.buffer);
+    }
+
+    // 写出text的内容, 直接创建或截断目标文件
+    void writeText(const std::string& target) {
+        path = target;
+        parts.push_back({const_cast<char*>(text.data()), text.size()});
+    }
+
+    // 写出image的内容, 先写入临时文件再重命名
+    void writeImage(const std::string& target) {
+        path = target;
+        parts.assign(image.parts, image.parts + image.partCount);
+        replace = true;
+    }
+};
+
+using PipelineTaskFn = std::function<void(size_t index, std::vector<PipelineInput>& inputs, PipelineOutput& output, BatchResult& result)>;
+
+// 任务完成后根据写出结果更新处理结果
+inline void finishPipelineOutput(PipelineOutput& output, BatchResult& result, bool written) {
+    if (!result.success) return;
+    if (written) {
+        result.output += output.successLog;
+        if (output.onWritten) output.onWritten();
+    } else {
+        result.success = false;
+        result.error += output.failure + "\n";
+    }
+}
+
+// 阻塞执行器: 使用runBatch的线程池, 输入文件映射到内存, 输出同步写出
+// 每个任务按输入大小的两倍(映射的输入和与其大小相近的输出)占用内存预算
+inline BatchSummary runBlockingPipeline(const std::vector<std::vector<std::string>>& inputPaths, const std::vector<uintmax_t>& weights,
+                                        unsigned jobs, uint64_t memoryBudget, const PipelineTaskFn& task) {
+    std::vector<uintmax_t> footprints(weights.size());
+    for (size_t i = 0; i < weights.size(); i++) {
+        footprints[i] = weights[i] * 2;
+    }
+    size_t retainLimit = memoryBudget > 0 ? memoryBudget / std::max(1u, jobs) : SIZE_MAX;
+    return runBatch(footprints, jobs, memoryBudget, [&](size_t index, BatchResult& result) {
+        std::vector<PipelineInput> inputs(inputPaths[index].size());
+        for (size_t k = 0; k < inputs.size(); k++) {
+            PipelineInput& input = inputs[k];
+            input.path = inputPaths[index][k];
+            if (input.mapped.open(input.path, true)) {
+                input.data = input.mapped.mutableData();
+                input.size = input.mapped.size();
+            } else {
+                input.error = errno != 0 ? errno : EIO;
+            }
+        }
+
+        thread_local PipelineOutput output;
+        output.reset();
+        task(index, inputs, output, result);
+
+        bool written = true;
+        if (result.success && !output.path.empty()) {
+            if (output.replace) {
+                written = writeFileGather(output.path, output.parts.data(), static_cast<int>(output.parts.size()));
+            } else {
+                int fd = ::open(output.path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+                written = fd >= 0 && writevFully(fd, output.parts.data(), static_cast<int>(output.parts.size()));
+                if (fd >= 0 && ::close(fd) != 0) written = false;
+            }
+        }
+        finishPipelineOutput(output, result, written);
+        output.trim(retainLimit);
+    });
+}
+
+// io_uring执行器
+// 调用线程提交所有文件的打开, 读取, 写出和关闭; 一个文件的全部输入读完后交给工作线程处理,
+// 工作线程处理完成后通过eventfd唤醒调用线程开始写出
+// 按顺序接收任务, 正在进行的任务的输入输出缓冲区总大小不超过memoryBudget(按遍历目录时的文件大小估算),
+// 单个任务超过预算时单独进行; 结果按任务顺序输出
+class IoUringPipeline {
+public:
+    IoUringPipeline(const std::vector<std::vector<std::string>>& inputPaths, const std::vector<uintmax_t>& weights,
+                    unsigned workers, size_t memoryBudget, const PipelineTaskFn& task)
+        : inputPaths_(inputPaths), weights_(weights), workerCount_(std::max(1u, workers)),
+          memoryBudget_(memoryBudget), task_(task), jobs_(inputPaths.size()) {}
+
+    ~IoUringPipeline() {
+        stopWorkers();
+        if (eventFd_ >= 0) ::close(eventFd_);
+    }
+
+    // 创建io_uring, 内核不支持需要的操作时返回false
+    bool init() {
+        const std::vector<uint8_t> ops = {IORING_OP_OPENAT, IORING_OP_READ, IORING_OP_WRITEV, IORING_OP_CLOSE};
+        if (!ring_.init(queueDepth, ops)) return false;
+        eventFd_ = eventfd(0, EFD_CLOEXEC);
+        return eventFd_ >= 0;
+    }
+
+    BatchSummary run() {
+        for (unsigned w = 0; w < workerCount_; w++) {
+            workers_.emplace_back([this] { workerLoop(); });
+        }
+        armWakeup();
+        admitJobs();
+        while (finishedCount_ < jobs_.size()) {
+            startWrites();
+            if (!ring_.submitAndWait(1)) {
+                throw std::runtime_error("io_uring_enter failed");
+            }
+            struct io_uring_cqe cqe;
+            while (ring_.popCqe(cqe)) {
+                handleCompletion(cqe);
+            }
+            admitJobs();
+        }
+        stopWorkers();
+        return summary_;
+    }
+
+private:
+    static constexpr unsigned queueDepth = 256;
+
+    // 完成事件的user_data: 任务序号 << 8 | 输入序号 << 4 | 操作
+    enum Operation : uint64_t {
+        OpenInput,
+        ReadInput,
+        CloseInput,
+        OpenOutput,
+        WriteOutput,
+        CloseOutput,
+        Wakeup,
+    };
+
+    struct Job {
+        std::vector<PipelineInput> inputs;
+        std::vector<int> inputFds;
+        std::vector<size_t> inputRead;
+        size_t pendingInputs = 0;
+        std::unique_ptr<PipelineOutput> output;
+        BatchResult result;
+        size_t reserved = 0; // 计入内存预算的字节数
+        bool done = false;
+
+        // 写出状态
+        std::string writePath;
+        int outputFd = -1;
+        size_t nextPart = 0;
+        uint64_t written = 0;
+        bool writeFailed = false;
+    };
+
+    static uint64_t userData(size_t job, size_t input, Operation op) {
+        return (static_cast<uint64_t>(job) << 8) | (input << 4) | op;
+    }
+
+    // 取得提交项; 提交队列已满时先提交已有的项
+    struct io_uring_sqe* sqe() {
+        struct io_uring_sqe* entry = ring_.getSqe();
+        if (!entry) {
+            ring_.submitAndWait(0);
+            entry = ring_.getSqe();
+        }
+        if (!entry) {
+            throw std::runtime_error("io_uring submission queue is full");
+        }
+        inFlightOps_++;
+        return entry;
+    }
+
+    void prepOpen(size_t job, size_t input, Operation op, const std::string& path, int flags) {
+        struct io_uring_sqe* entry = sqe();
+        entry->opcode = IORING_OP_OPENAT;
+        entry->fd = AT_FDCWD;
+        entry->addr = reinterpret_cast<uint64_t>(path.c_str());
+        entry->open_flags = flags | O_CLOEXEC;
+        entry->len = 0644;
+        entry->user_data = userData(job, input, op);
+    }
+
+    void prepClose(size_t job, size_t input, Operation op, int fd) {
+        struct io_uring_sqe* entry = sqe();
+        entry->opcode = IORING_OP_CLOSE;
+        entry->fd = fd;
+        entry->user_data = userData(job, input, op);
+    }
+
+    void prepRead(size_t index, size_t input) {
+        Job& job = jobs_[index];
+        PipelineInput& file = job.inputs[input];
+        struct io_uring_sqe* entry = sqe();
+        entry->opcode = IORING_OP_READ;
+        entry->fd = job.inputFds[input];
+        entry->addr = reinterpret_cast<uint64_t>(file.buffer.get() + job.inputRead[input]);
+        entry->len = static_cast<uint32_t>(std::min<size_t>(file.size - job.inputRead[input], 1u << 30));
+        entry->off = job.inputRead[input];
+        entry->user_data = userData(index, input, ReadInput);
+    }
+
+    void prepWrite(size_t index) {
+        Job& job = jobs_[index];
+        std::vector<struct iovec>& parts = job.output->parts;
+        struct io_uring_sqe* entry = sqe();
+        entry->opcode = IORING_OP_WRITEV;
+        entry->fd = job.outputFd;
+        entry->addr = reinterpret_cast<uint64_t>(parts.data() + job.nextPart);
+        entry->len = static_cast<uint32_t>(std::min<size_t>(parts.size() - job.nextPart, IOV_MAX));
+        entry->off = job.written;
+        entry->user_data = userData(index, 0, WriteOutput);
+    }
+
+    // 工作线程完成任务时写eventfd, 这里始终保持一个对它的读取
+    void armWakeup() {
+        struct io_uring_sqe* entry = sqe();
+        entry->opcode = IORING_OP_READ;
+        entry->fd = eventFd_;
+        entry->addr = reinterpret_cast<uint64_t>(&wakeupValue_);
+        entry->len = sizeof(wakeupValue_);
+        entry->user_data = userData(0, 0, Wakeup);
+    }
+
+    // 在内存预算和队列深度允许的范围内开始读取后续任务的输入
+    void admitJobs() {
+        while (nextJob_ < jobs_.size()) {
+            size_t inputCount = inputPaths_[nextJob_].size();
+            size_t reserve = static_cast<size_t>(weights_[nextJob_]);
+            bool idle = reservedBytes_ == 0;
+            if (!idle && reservedBytes_ + reserve > memoryBudget_) break;
+            if (inFlightOps_ + inputCount * 2 + 2 > ring_.capacity()) break;
+
+            size_t index = nextJob_++;
+            Job& job = jobs_[index];
+            job.reserved = reserve;
+            reservedBytes_ += reserve;
+            RunStats::noteInFlightBytes(reservedBytes_);
+            job.inputs = std::vector<PipelineInput>(inputCount);
+            job.inputFds.assign(inputCount, -1);
+            job.inputRead.assign(inputCount, 0);
+            job.pendingInputs = inputCount;
+            for (size_t k = 0; k < inputCount; k++) {
+                job.inputs[k].path = inputPaths_[index][k];
+                prepOpen(index, k, OpenInput, job.inputs[k].path, O_RDONLY);
+            }
+            if (inputCount == 0) {
+                dispatch(index);
+            }
+        }
+    }
+
+    void handleCompletion(const struct io_uring_cqe& cqe) {
+        inFlightOps_--;
+        size_t index = static_cast<size_t>(cqe.user_data >> 8);
+        size_t input = static_cast<size_t>((cqe.user_data >> 4) & 0xF);
+        Operation op = static_cast<Operation>(cqe.user_data & 0xF);
+
+        switch (op) {
+        case OpenInput:
+            inputOpened(index, input, cqe.res);
+            break;
+        case ReadInput:
+            inputRead(index, input, cqe.res);
+            break;
+        case CloseInput:
+            break;
+        case OpenOutput:
+            outputOpened(index, cqe.res);
+            break;
+        case WriteOutput:
+            outputWritten(index, cqe.res);
+            break;
+        case CloseOutput:
+            outputClosed(index, cqe.res);
+            break;
+        case Wakeup:
+            collectProcessed();
+            armWakeup();
+            break;
+        }
+    }
+
+    void inputOpened(size_t index, size_t input, int res) {
+        Job& job = jobs_[index];
+        PipelineInput& file = job.inputs[input];
+        if (res < 0) {
+            file.error = -res;
+            inputFinished(index);
+            return;
+        }
+        job.inputFds[input] = res;
+
+        // 文件大小在打开后同步获取, 元数据此时已在缓存中
+        struct stat st;
+        if (fstat(res, &st) != 0) {
+            file.error = errno;
+            closeInput(index, input);
+            return;
+        }
+        file.size = static_cast<size_t>(st.st_size);
+        file.buffer.reset(new uint8_t[file.size > 0 ? file.size : 1]);
+        file.data = file.buffer.get();
+        if (file.size == 0) {
+            closeInput(index, input);
+            return;
+        }
+        prepRead(index, input);
+    }
+
+    void inputRead(size_t index, size_t input, int res) {
+        Job& job = jobs_[index];
+        PipelineInput& file = job.inputs[input];
+        if (res < 0) {
+            file.error = -res;
+            closeInput(index, input);
+            return;
+        }
+        job.inputRead[input] += static_cast<size_t>(res);
+        RunStats::addBytesIn(static_cast<uint64_t>(res));
+        if (res > 0 && job.inputRead[input] < file.size) {
+            prepRead(index, input);
+            return;
+        }
+        // 文件在读取过程中变短时只使用已读到的部分
+        file.size = job.inputRead[input];
+        closeInput(index, input);
+    }
+
+    // 输入文件的关闭不需要等待完成
+    void closeInput(size_t index, size_t input) {
+        Job& job = jobs_[index];
+        prepClose(index, input, CloseInput, job.inputFds[input]);
+        job.inputFds[input] = -1;
+        inputFinished(index);
+    }
+
+    void inputFinished(size_t index) {
+        if (--jobs_[index].pendingInputs == 0) {
+            dispatch(index);
+        }
+    }
+
+    // 输入全部就绪, 交给工作线程
+    void dispatch(size_t index) {
+        Job& job = jobs_[index];
+        if (!freeOutputs_.empty()) {
+            job.output = std::move(freeOutputs_.back());
+            freeOutputs_.pop_back();
+        } else {
+            job.output.reset(new PipelineOutput());
+        }
+        job.output->reset();
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            ready_.push_back(index);
+        }
+        readyCondition_.notify_one();
+    }
+
+    void workerLoop() {
+        while (true) {
+            size_t index;
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                readyCondition_.wait(lock, [this] { return stopping_ || !ready_.empty(); });
+                if (ready_.empty()) return;
+                index = ready_.front();
+                ready_.pop_front();
+            }
+
+            Job& job = jobs_[index];
+            try {
+                task_(index, job.inputs, *job.output, job.result);
+            } catch (const std::exception& e) {
+                job.result.success = false;
+                job.result.error += e.what();
+                job.result.error += '\n';
+            }
+
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                processed_.push_back(index);
+            }
+            uint64_t one = 1;
+            ssize_t n = ::write(eventFd_, &one, sizeof(one));
+            (void)n;
+        }
+    }
+
+    void collectProcessed() {
+        std::deque<size_t> processed;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            processed.swap(processed_);
+        }
+        for (size_t index : processed) {
+            Job& job = jobs_[index];
+            if (job.result.success && !job.output->path.empty()) {
+                pendingWrites_.push_back(index);
+            } else {
+                finishJob(index, true);
+            }
+        }
+    }
+
+    // 在队列深度允许的范围内开始写出
+    void startWrites() {
+        while (!pendingWrites_.empty() && inFlightOps_ + 2 <= ring_.capacity()) {
+            size_t index = pendingWrites_.front();
+            pendingWrites_.pop_front();
+            Job& job = jobs_[index];
+            const PipelineOutput& output = *job.output;
+            reservedBytes_ -= job.reserved;
+            job.reserved = 0;
+            for (const struct iovec& part : output.parts) {
+                job.reserved += part.iov_len;
+            }
+            reservedBytes_ += job.reserved;
+            RunStats::noteInFlightBytes(reservedBytes_);
+            job.writePath = output.replace ? output.path + ".tmp" : output.path;
+            prepOpen(index, 0, OpenOutput, job.writePath, O_WRONLY | O_CREAT | O_TRUNC);
+        }
+    }
+
+    void outputOpened(size_t index, int res) {
+        Job& job = jobs_[index];
+        if (res < 0) {
+            finishJob(index, false);
+            return;
+        }
+        job.outputFd = res;
+        job.nextPart = 0;
+        job.written = 0;
+        skipWrittenParts(job, 0);
+        if (job.nextPart < job.output->parts.size()) {
+            prepWrite(index);
+        } else {
+            prepClose(index, 0, CloseOutput, job.outputFd);
+        }
+    }
+
+    // 跳过已完整写出的块, 部分写出的块调整起始位置
+    static void skipWrittenParts(Job& job, size_t written) {
+        std::vector<struct iovec>& parts = job.output->parts;
+        while (job.nextPart < parts.size() && written >= parts[job.nextPart].iov_len) {
+            written -= parts[job.nextPart].iov_len;
+            job.nextPart++;
+        }
+        if (job.nextPart < parts.size()) {
+            parts[job.nextPart].iov_base = static_cast<uint8_t*>(parts[job.nextPart].iov_base) + written;
+            parts[job.nextPart].iov_len -= written;
+        }
+    }
+
+    void outputWritten(size_t index, int res) {
+        Job& job = jobs_[index];
+        if (res <= 0) {
+            job.writeFailed = true;
+            prepClose(index, 0, CloseOutput, job.outputFd);
+            return;
+        }
+        RunStats::addBytesOut(static_cast<uint64_t>(res));
+        job.written += static_cast<uint64_t>(res);
+        skipWrittenParts(job, static_cast<size_t>(res));
+        if (job.nextPart < job.output->parts.size()) {
+            prepWrite(index);
+        } else {
+            prepClose(index, 0, CloseOutput, job.outputFd);
+        }
+    }
+
+    void outputClosed(size_t index, int res) {
+        Job& job = jobs_[index];
+        job.outputFd = -1;
+        bool ok = res >= 0 && !job.writeFailed;
+        if (job.output->replace) {
+            // 重命名是元数据操作, 直接同步进行
+            if (!ok || std::rename(job.writePath.c_str(), job.output->path.c_str()) != 0) {
+                std::remove(job.writePath.c_str());
+                ok = false;
+            }
+        }
+        finishJob(index, ok);
+    }
+
+    void finishJob(size_t index, bool written) {
+        Job& job = jobs_[index];
+        finishPipelineOutput(*job.output, job.result, written);
+        reservedBytes_ -= job.reserved;
+        job.reserved = 0;
+        job.done = true;
+        finishedCount_++;
+
+        // 释放缓冲区, 输出对象留给后续任务使用
+        job.output->trim(memoryBudget_ / workerCount_);
+        freeOutputs_.push_back(std::move(job.output));
+        std::vector<PipelineInput>().swap(job.inputs);
+
+        // 按任务顺序输出已完成的结果
+        while (nextPrint_ < jobs_.size() && jobs_[nextPrint_].done) {
+            printBatchResult(jobs_[nextPrint_].result, summary_);
+            jobs_[nextPrint_].result = BatchResult();
+            nextPrint_++;
+        }
+    }
+
+    void stopWorkers() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopping_ = true;
+        }
+        readyCondition_.notify_all();
+        for (auto& worker : workers_) {
+            worker.join();
+        }
+        workers_.clear();
+    }
+
+    const std::vector<std::vector<std::string>>& inputPaths_;
+    const std::vector<uintmax_t>& weights_;
+    unsigned workerCount_;
+    size_t memoryBudget_;
+    const PipelineTaskFn& task_;
+
+    IoUring ring_;
+    int eventFd_ = -1;
+    uint64_t wakeupValue_ = 0;
+    size_t inFlightOps_ = 0;
+
+    std::vector<Job> jobs_;
+    size_t nextJob_ = 0;
+    size_t finishedCount_ = 0;
+    size_t nextPrint_ = 0;
+    size_t reservedBytes_ = 0;
+    std::deque<size_t> pendingWrites_;
+    std::vector<std::unique_ptr<PipelineOutput>> freeOutputs_;
+    BatchSummary summary_;
+
+    std::vector<std::thread> workers_;
+    std::mutex mutex_;
+    std::condition_variable readyCondition_;
+    std::deque<size_t> ready_;
+    std::deque<size_t> processed_;
+    bool stopping_ = false;
+};
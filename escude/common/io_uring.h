@@ -0,0 +1,140 @@
+#pragma once
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+// io_uring的最小封装
+// 直接使用系统调用, 不依赖liburing; 只支持单线程提交和收割
+// 内核不支持io_uring或被禁止使用(例如容器的seccomp策略)时init返回false, 由调用者改用阻塞I/O
+class IoUring {
+public:
+    IoUring() = default;
+    IoUring(const IoUring&) = delete;
+    IoUring& operator=(const IoUring&) = delete;
+
+    ~IoUring() {
+        if (sqRing_ != MAP_FAILED) munmap(sqRing_, sqRingSize_);
+        if (cqRing_ != MAP_FAILED && cqRing_ != sqRing_) munmap(cqRing_, cqRingSize_);
+        if (sqes_ != MAP_FAILED) munmap(sqes_, sqesSize_);
+        if (fd_ >= 0) ::close(fd_);
+    }
+
+    // 创建队列, 并检查需要的操作是否都被支持
+    bool init(unsigned entries, const std::vector<uint8_t>& requiredOps) {
+        struct io_uring_params params;
+        std::memset(&params, 0, sizeof(params));
+        fd_ = static_cast<int>(syscall(__NR_io_uring_setup, entries, &params));
+        if (fd_ < 0) return false;
+
+        sqRingSize_ = params.sq_off.array + params.sq_entries * sizeof(uint32_t);
+        cqRingSize_ = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+        bool singleMap = params.features & IORING_FEAT_SINGLE_MMAP;
+        if (singleMap) {
+            sqRingSize_ = cqRingSize_ = std::max(sqRingSize_, cqRingSize_);
+        }
+        sqRing_ = mmap(nullptr, sqRingSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_SQ_RING);
+        if (sqRing_ == MAP_FAILED) return false;
+        cqRing_ = singleMap ? sqRing_
+                            : mmap(nullptr, cqRingSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_CQ_RING);
+        if (cqRing_ == MAP_FAILED) return false;
+        sqesSize_ = params.sq_entries * sizeof(struct io_uring_sqe);
+        sqes_ = mmap(nullptr, sqesSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_SQES);
+        if (sqes_ == MAP_FAILED) return false;
+
+        uint8_t* sq = static_cast<uint8_t*>(sqRing_);
+        sqHead_ = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+        sqTail_ = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+        sqMask_ = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+        sqArray_ = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+        sqEntries_ = params.sq_entries;
+
+        uint8_t* cq = static_cast<uint8_t*>(cqRing_);
+        cqHead_ = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+        cqTail_ = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+        cqMask_ = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+        cqes_ = reinterpret_cast<struct io_uring_cqe*>(cq + params.cq_off.cqes);
+
+        return supportsAll(requiredOps);
+    }
+
+    unsigned capacity() const { return sqEntries_; }
+
+    // 取得一个空闲的提交项, 队列已满时返回nullptr
+    struct io_uring_sqe* getSqe() {
+        unsigned head = __atomic_load_n(sqHead_, __ATOMIC_ACQUIRE);
+        if (localTail_ - head >= sqEntries_) return nullptr;
+        struct io_uring_sqe* sqe = static_cast<struct io_uring_sqe*>(sqes_) + (localTail_ & sqMask_);
+        sqArray_[localTail_ & sqMask_] = localTail_ & sqMask_;
+        localTail_++;
+        std::memset(sqe, 0, sizeof(*sqe));
+        return sqe;
+    }
+
+    // 提交所有新的提交项, 并等待至少waitCount个完成事件
+    bool submitAndWait(unsigned waitCount) {
+        unsigned toSubmit = localTail_ - submittedTail_;
+        __atomic_store_n(sqTail_, localTail_, __ATOMIC_RELEASE);
+        submittedTail_ = localTail_;
+        while (true) {
+            int ret = static_cast<int>(syscall(__NR_io_uring_enter, fd_, toSubmit, waitCount,
+                                               waitCount > 0 ? IORING_ENTER_GETEVENTS : 0, nullptr, 0));
+            if (ret >= 0) return true;
+            if (errno == EINTR) {
+                // 被信号中断时提交项可能已部分提交, 之后只需等待
+                toSubmit = 0;
+                continue;
+            }
+            return false;
+        }
+    }
+
+    // 取出一个完成事件, 没有时返回false
+    bool popCqe(struct io_uring_cqe& cqe) {
+        unsigned head = *cqHead_;
+        if (head == __atomic_load_n(cqTail_, __ATOMIC_ACQUIRE)) return false;
+        cqe = cqes_[head & cqMask_];
+        __atomic_store_n(cqHead_, head + 1, __ATOMIC_RELEASE);
+        return true;
+    }
+
+private:
+    bool supportsAll(const std::vector<uint8_t>& ops) {
+        size_t size = sizeof(struct io_uring_probe) + 256 * sizeof(struct io_uring_probe_op);
+        std::vector<uint8_t> storage(size, 0);
+        auto* probe = reinterpret_cast<struct io_uring_probe*>(storage.data());
+        if (syscall(__NR_io_uring_register, fd_, IORING_REGISTER_PROBE, probe, 256) < 0) return false;
+        for (uint8_t op : ops) {
+            if (op > probe->last_op || !(probe->ops[op].flags & IO_URING_OP_SUPPORTED)) return false;
+        }
+        return true;
+    }
+
+    int fd_ = -1;
+    void* sqRing_ = MAP_FAILED;
+    void* cqRing_ = MAP_FAILED;
+    void* sqes_ = MAP_FAILED;
+    size_t sqRingSize_ = 0;
+    size_t cqRingSize_ = 0;
+    size_t sqesSize_ = 0;
+
+    unsigned* sqHead_ = nullptr;
+    unsigned* sqTail_ = nullptr;
+    unsigned* sqArray_ = nullptr;
+    unsigned sqMask_ = 0;
+    unsigned sqEntries_ = 0;
+    unsigned localTail_ = 0;
+    unsigned submittedTail_ = 0;
+
+    unsigned* cqHead_ = nullptr;
+    unsigned* cqTail_ = nullptr;
+    struct io_uring_cqe* cqes_ = nullptr;
+    unsigned cqMask_ = 0;
+};
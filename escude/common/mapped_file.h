@@ -0,0 +1,127 @@
+#pragma once
+
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "run_stats.h"
+
+// 只读文件映射
+// 优先使用mmap, 直接在页缓存上解析, 不把文件复制到堆上;
+// 对于无法映射的文件(例如管道或特殊文件系统), 退化为read()读入内存
+// 以写时复制方式打开时可以修改映射的内容(例如原地解密), 修改只在进程内可见, 不影响文件
+class MappedFile {
+public:
+    MappedFile() = default;
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    ~MappedFile() {
+        close();
+    }
+
+    // 打开文件, 失败时返回false, 由调用者决定错误信息
+    // copyOnWrite为true时可以通过mutableData修改内容
+    bool open(const std::string& path, bool copyOnWrite = false) {
+        close();
+        PhaseTimer timer(StatPhase::Read);
+
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            return false;
+        }
+
+        struct stat st;
+        if (fstat(fd, &st) != 0) {
+            ::close(fd);
+            return false;
+        }
+
+        if (S_ISREG(st.st_mode)) {
+            size_ = static_cast<size_t>(st.st_size);
+            if (size_ == 0) {
+                ::close(fd);
+                return true;
+            }
+
+            int protection = copyOnWrite ? PROT_READ | PROT_WRITE : PROT_READ;
+            void* addr = mmap(nullptr, size_, protection, MAP_PRIVATE, fd, 0);
+            if (addr != MAP_FAILED) {
+                // 脚本文件总是顺序解析
+                madvise(addr, size_, MADV_SEQUENTIAL);
+                data_ = static_cast<const uint8_t*>(addr);
+                mapped_ = true;
+                writable_ = copyOnWrite;
+                ::close(fd);
+                RunStats::addBytesIn(size_);
+                return true;
+            }
+        }
+
+        bool ok = readAll(fd, S_ISREG(st.st_mode) ? static_cast<size_t>(st.st_size) : 0);
+        writable_ = ok;
+        ::close(fd);
+        if (ok) RunStats::addBytesIn(size_);
+        return ok;
+    }
+
+    void close() {
+        if (mapped_) {
+            munmap(const_cast<uint8_t*>(data_), size_);
+        }
+        buffer_.reset();
+        data_ = nullptr;
+        size_ = 0;
+        mapped_ = false;
+        writable_ = false;
+    }
+
+    const uint8_t* data() const { return data_; }
+    size_t size() const { return size_; }
+    bool isMapped() const { return mapped_; }
+
+    // 可以修改的内容: 以写时复制方式映射或读入内存时有效, 否则为nullptr
+    uint8_t* mutableData() const { return writable_ ? const_cast<uint8_t*>(data_) : nullptr; }
+
+private:
+    bool readAll(int fd, size_t sizeHint) {
+        size_t capacity = sizeHint > 0 ? sizeHint : 64 * 1024;
+        size_t used = 0;
+        buffer_.reset(new uint8_t[capacity]);
+
+        while (true) {
+            if (used == capacity) {
+                std::unique_ptr<uint8_t[]> grown(new uint8_t[capacity * 2]);
+                std::copy(buffer_.get(), buffer_.get() + used, grown.get());
+                buffer_ = std::move(grown);
+                capacity *= 2;
+            }
+            ssize_t n = ::read(fd, buffer_.get() + used, capacity - used);
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                buffer_.reset();
+                return false;
+            }
+            if (n == 0) break;
+            used += static_cast<size_t>(n);
+        }
+
+        data_ = buffer_.get();
+        size_ = used;
+        return true;
+    }
+
+    const uint8_t* data_ = nullptr;
+    size_t size_ = 0;
+    bool mapped_ = false;
+    bool writable_ = false;
+    std::unique_ptr<uint8_t[]> buffer_;
+};
@@ -0,0 +1,167 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// 多模式查找和定长替换
+// 所有模式构建一个Aho-Corasick自动机, 每个文件只扫描一遍即可找到全部模式的所有出现位置, 扫描时间与模式数量无关.
+// 自动机展开为完整的状态转移表, 每个字节只查一次表, 没有失败链接的回退; 模式中没有出现的字节归为同一类,
+// 表的列数为模式中出现的不同字节数加1. 表项为目标状态的行偏移, 最高位表示该状态有模式结束
+
+// 一个模式的出现位置
+struct ReplaceMatch {
+    size_t offset;
+    uint32_t pattern;
+};
+
+class ReplaceAutomaton {
+public:
+    // 添加模式, 返回模式编号(按添加顺序); 添加完成后调用build
+    uint32_t add(std::string_view pattern) {
+        if (pattern.empty()) {
+            throw std::runtime_error("Empty replacement pattern");
+        }
+        patterns_.emplace_back(pattern);
+        return static_cast<uint32_t>(patterns_.size() - 1);
+    }
+
+    void build() {
+        // 字节分类: 类0为模式中没有出现的字节
+        byteClass_.fill(0);
+        classCount_ = 1;
+        for (const std::string& pattern : patterns_) {
+            for (unsigned char c : pattern) {
+                if (byteClass_[c] == 0) byteClass_[c] = static_cast<uint16_t>(classCount_++);
+            }
+        }
+
+        // 字典树, 不存在的转移为none
+        std::vector<uint32_t> next(classCount_, none);
+        terminal_.assign(1, none);
+        for (uint32_t id = 0; id < patterns_.size(); id++) {
+            uint32_t state = 0;
+            for (unsigned char c : patterns_[id]) {
+                uint32_t& target = next[state * classCount_ + byteClass_[c]];
+                if (target == none) {
+                    target = static_cast<uint32_t>(terminal_.size());
+                    terminal_.push_back(none);
+                    next.resize(next.size() + classCount_, none);
+                }
+                state = next[state * classCount_ + byteClass_[c]];
+            }
+            if (terminal_[state] != none) {
+                throw std::runtime_error("Duplicate replacement pattern");
+            }
+            terminal_[state] = id;
+        }
+
+        size_t stateCount = terminal_.size();
+        if (stateCount * classCount_ > flag) {
+            throw std::runtime_error("Too many replacement patterns");
+        }
+
+        // 按深度顺序计算失败链接, 同时补全转移: 不存在的转移等于失败状态的同一转移
+        // 输出链接指向失败链上最近的有模式结束的状态
+        std::vector<uint32_t> fail(stateCount, 0);
+        outputLink_.assign(stateCount, none);
+        std::vector<uint32_t> queue;
+        queue.reserve(stateCount);
+        for (size_t c = 0; c < classCount_; c++) {
+            uint32_t& target = next[c];
+            if (target == none) {
+                target = 0;
+            } else {
+                queue.push_back(target);
+            }
+        }
+        for (size_t head = 0; head < queue.size(); head++) {
+            uint32_t state = queue[head];
+            const uint32_t* fallback = &next[fail[state] * classCount_];
+            for (size_t c = 0; c < classCount_; c++) {
+                uint32_t& target = next[state * classCount_ + c];
+                if (target == none) {
+                    target = fallback[c];
+                    continue;
+                }
+                uint32_t failure = fallback[c];
+                fail[target] = failure;
+                outputLink_[target] = terminal_[failure] != none ? failure : outputLink_[failure];
+                queue.push_back(target);
+            }
+        }
+
+        table_.resize(next.size());
+        for (size_t i = 0; i < next.size(); i++) {
+            uint32_t target = next[i];
+            bool reports = terminal_[target] != none || outputLink_[target] != none;
+            table_[i] = static_cast<uint32_t>(target * classCount_) | (reports ? flag : 0);
+        }
+    }
+
+    size_t patternCount() const { return patterns_.size(); }
+    size_t patternLength(uint32_t pattern) const { return patterns_[pattern].size(); }
+    size_t stateCount() const { return terminal_.size(); }
+    size_t classCount() const { return classCount_; }
+
+    // 查找data中所有模式的全部出现位置(包括互相重叠的), 按结束位置的顺序调用callback(起点, 模式编号)
+    template <typename Callback>
+    void scan(const uint8_t* data, size_t size, Callback&& callback) const {
+        const uint32_t* table = table_.data();
+        const uint16_t* byteClass = byteClass_.data();
+        uint32_t row = 0;
+        for (size_t i = 0; i < size; i++) {
+            uint32_t entry = table[row + byteClass[data[i]]];
+            row = entry & ~flag;
+            if (entry & flag) {
+                uint32_t state = static_cast<uint32_t>(row / classCount_);
+                if (terminal_[state] == none) state = outputLink_[state];
+                for (; state != none; state = outputLink_[state]) {
+                    uint32_t pattern = terminal_[state];
+                    callback(i + 1 - patterns_[pattern].size(), pattern);
+                }
+            }
+        }
+    }
+
+    // 按最左最长的规则选择互不重叠的出现位置, 结果按位置排序写入selected
+    // 完全包含在已选位置中的出现位置(例如全名中的名字)直接忽略; 与已选位置部分重叠而放弃的出现位置写入collisions,
+    // 每项为(放弃的位置, 与它重叠的已选位置)
+    void resolve(std::vector<ReplaceMatch>& matches, std::vector<ReplaceMatch>& selected,
+                 std::vector<std::pair<ReplaceMatch, ReplaceMatch>>& collisions) const {
+        std::sort(matches.begin(), matches.end(), [&](const ReplaceMatch& a, const ReplaceMatch& b) {
+            if (a.offset != b.offset) return a.offset < b.offset;
+            return patterns_[a.pattern].size() > patterns_[b.pattern].size();
+        });
+        selected.clear();
+        collisions.clear();
+        size_t end = 0;
+        for (const ReplaceMatch& match : matches) {
+            if (!selected.empty() && match.offset < end) {
+                if (match.offset + patterns_[match.pattern].size() > end) {
+                    collisions.emplace_back(match, selected.back());
+                }
+                continue;
+            }
+            selected.push_back(match);
+            end = match.offset + patterns_[match.pattern].size();
+        }
+    }
+
+private:
+    static constexpr uint32_t none = UINT32_MAX;
+    static constexpr uint32_t flag = 0x80000000u;
+
+    std::vector<std::string> patterns_;
+    std::array<uint16_t, 256> byteClass_{};
+    size_t classCount_ = 1;
+    std::vector<uint32_t> table_;      // 状态数 * 类数
+    std::vector<uint32_t> terminal_;   // 在该状态结束的模式, 没有时为none
+    std::vector<uint32_t> outputLink_; // 失败链上最近的有模式结束的状态
+};
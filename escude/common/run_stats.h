@@ -0,0 +1,205 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+
+#include <sys/resource.h>
+
+// 运行统计
+// 各阶段耗时, 输入输出字节数, 字符串数量, 内存分配次数, 批处理占用的内存预算和峰值内存, 由--stats输出为JSON
+// 每个线程在自己的计数器上累加, 线程结束时合并到全局结果; 未启用时各统计点只检查一个标志
+
+enum class StatPhase {
+    Walk,      // 遍历目录, 计算输出路径
+    Read,      // 打开和映射文件, 从封包读取和解压, 解密.001脚本
+    Parse,     // 解析脚本结构, 切分文本行, 构建新脚本
+    Transcode, // 编码转换
+    Write,     // 写出文件
+    Count,
+};
+
+inline const char* statPhaseName(StatPhase phase) {
+    static const char* const names[] = {"walk", "read", "parse", "transcode", "write"};
+    return names[static_cast<int>(phase)];
+}
+
+struct StatCounters {
+    uint64_t phaseNanos[static_cast<int>(StatPhase::Count)] = {};
+    uint64_t bytesIn = 0;
+    uint64_t bytesOut = 0;
+    uint64_t strings = 0;
+
+    void add(const StatCounters& other) {
+        for (int i = 0; i < static_cast<int>(StatPhase::Count); i++) {
+            phaseNanos[i] += other.phaseNanos[i];
+        }
+        bytesIn += other.bytesIn;
+        bytesOut += other.bytesOut;
+        strings += other.strings;
+    }
+};
+
+class RunStats {
+public:
+    struct FileCounts {
+        int processed = 0;
+        int errors = 0;
+        int skipped = 0;
+    };
+
+    static RunStats& global() {
+        static RunStats stats;
+        return stats;
+    }
+
+    static bool enabled() {
+        return enabled_.load(std::memory_order_relaxed);
+    }
+
+    void enable() {
+        enabled_.store(true, std::memory_order_relaxed);
+        start_ = std::chrono::steady_clock::now();
+    }
+
+    static void addBytesIn(uint64_t bytes) {
+        if (enabled()) local().counters.bytesIn += bytes;
+    }
+
+    static void addBytesOut(uint64_t bytes) {
+        if (enabled()) local().counters.bytesOut += bytes;
+    }
+
+    static void addStrings(uint64_t count) {
+        if (enabled()) local().counters.strings += count;
+    }
+
+    // 批处理中正在处理的任务占用的内存预算, 记录最大值
+    static void noteInFlightBytes(uint64_t bytes) {
+        if (!enabled()) return;
+        uint64_t peak = peakInFlight_.load(std::memory_order_relaxed);
+        while (bytes > peak && !peakInFlight_.compare_exchange_weak(peak, bytes, std::memory_order_relaxed)) {
+        }
+    }
+
+    // 由全局operator new调用, 见allocation_hooks.h
+    static void countAllocation() {
+        if (enabled()) allocations_.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void setFileCounts(int processed, int errors, int skipped) {
+        files_ = {processed, errors, skipped};
+    }
+
+    // 写出JSON报告, 应在所有工作线程结束后调用
+    void writeReport(const std::string& path, const std::string& mode, unsigned jobs) {
+        StatCounters total;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            total = merged_;
+        }
+        total.add(local().counters);
+        double wallSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_).count();
+
+        std::ofstream output(path);
+        if (!output) {
+            throw std::runtime_error("Cannot write stats file: " + path);
+        }
+        output << "{\n";
+        output << "  \"mode\": \"" << mode << "\",\n";
+        output << "  \"jobs\": " << jobs << ",\n";
+        output << "  \"wall_seconds\": " << wallSeconds << ",\n";
+        output << "  \"files\": {\"processed\": " << files_.processed << ", \"errors\": " << files_.errors
+               << ", \"skipped\": " << files_.skipped << "},\n";
+        // 各阶段时间为所有线程的累计值, 并行时总和可能超过wall_seconds
+        output << "  \"phase_seconds\": {";
+        for (int i = 0; i < static_cast<int>(StatPhase::Count); i++) {
+            output << (i > 0 ? ", " : "") << "\"" << statPhaseName(static_cast<StatPhase>(i)) << "\": " << total.phaseNanos[i] / 1e9;
+        }
+        output << "},\n";
+        output << "  \"bytes_in\": " << total.bytesIn << ",\n";
+        output << "  \"bytes_out\": " << total.bytesOut << ",\n";
+        output << "  \"strings\": " << total.strings << ",\n";
+        output << "  \"allocations\": " << allocations_.load(std::memory_order_relaxed) << ",\n";
+        output << "  \"peak_in_flight_bytes\": " << peakInFlight_.load(std::memory_order_relaxed) << ",\n";
+        output << "  \"peak_rss_bytes\": " << peakRssBytes() << "\n";
+        output << "}\n";
+    }
+
+private:
+    friend class PhaseTimer;
+
+    // 线程自己的计数器, 线程结束时合并到全局结果
+    struct ThreadState {
+        StatCounters counters;
+        StatPhase phase = StatPhase::Count; // 当前计时的阶段, Count表示没有计时
+        std::chrono::steady_clock::time_point since;
+
+        ~ThreadState() {
+            RunStats& stats = global();
+            std::lock_guard<std::mutex> lock(stats.mutex_);
+            stats.merged_.add(counters);
+        }
+
+        // 将上次切换以来的时间计入当前阶段
+        void charge(std::chrono::steady_clock::time_point now) {
+            if (phase != StatPhase::Count) {
+                counters.phaseNanos[static_cast<int>(phase)] +=
+                    std::chrono::duration_cast<std::chrono::nanoseconds>(now - since).count();
+            }
+            since = now;
+        }
+    };
+
+    static ThreadState& local() {
+        thread_local ThreadState state;
+        return state;
+    }
+
+    static uint64_t peakRssBytes() {
+        struct rusage usage;
+        if (getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+        return static_cast<uint64_t>(usage.ru_maxrss) * 1024; // Linux上单位为KB
+    }
+
+    static inline std::atomic<bool> enabled_{false};
+    static inline std::atomic<uint64_t> allocations_{0};
+    static inline std::atomic<uint64_t> peakInFlight_{0};
+
+    std::mutex mutex_;
+    StatCounters merged_;
+    FileCounts files_;
+    std::chrono::steady_clock::time_point start_;
+};
+
+// 阶段计时, 作用域内的时间计入指定阶段
+// 嵌套时内层阶段的时间只计入内层, 外层阶段在内层结束后继续计时
+class PhaseTimer {
+public:
+    explicit PhaseTimer(StatPhase phase) {
+        if (!RunStats::enabled()) return;
+        RunStats::ThreadState& state = RunStats::local();
+        state.charge(std::chrono::steady_clock::now());
+        previous_ = state.phase;
+        state.phase = phase;
+        active_ = true;
+    }
+
+    ~PhaseTimer() {
+        if (!active_) return;
+        RunStats::ThreadState& state = RunStats::local();
+        state.charge(std::chrono::steady_clock::now());
+        state.phase = previous_;
+    }
+
+    PhaseTimer(const PhaseTimer&) = delete;
+    PhaseTimer& operator=(const PhaseTimer&) = delete;
+
+private:
+    StatPhase previous_ = StatPhase::Count;
+    bool active_ = false;
+};
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define ESCUDE_SCAN_X86 1
+#include <immintrin.h>
+#endif
+
+// 字符串边界和换行查找
+// x86上使用SSE2/AVX2一次比较16/32字节, 运行时检测CPU选择实现, 其他平台使用逐字节查找
+
+namespace scan_detail {
+
+inline const uint8_t* findByteScalar(const uint8_t* p, const uint8_t* end, uint8_t value) {
+    while (p < end && *p != value) {
+        p++;
+    }
+    return p;
+}
+
+#ifdef ESCUDE_SCAN_X86
+__attribute__((target("sse2")))
+inline const uint8_t* findByteSse2(const uint8_t* p, const uint8_t* end, uint8_t value) {
+    const __m128i needle = _mm_set1_epi8(static_cast<char>(value));
+    while (end - p >= 16) {
+        __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, needle));
+        if (mask != 0) {
+            return p + __builtin_ctz(mask);
+        }
+        p += 16;
+    }
+    return findByteScalar(p, end, value);
+}
+
+__attribute__((target("avx2")))
+inline const uint8_t* findByteAvx2(const uint8_t* p, const uint8_t* end, uint8_t value) {
+    const __m256i needle = _mm256_set1_epi8(static_cast<char>(value));
+    while (end - p >= 32) {
+        __m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+        unsigned mask = static_cast<unsigned>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, needle)));
+        if (mask != 0) {
+            return p + __builtin_ctz(mask);
+        }
+        p += 32;
+    }
+    return findByteSse2(p, end, value);
+}
+#endif
+
+using FindByteFn = const uint8_t* (*)(const uint8_t*, const uint8_t*, uint8_t);
+
+inline FindByteFn selectFindByte() {
+#ifdef ESCUDE_SCAN_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) return findByteAvx2;
+    if (__builtin_cpu_supports("sse2")) return findByteSse2;
+#endif
+    return findByteScalar;
+}
+
+} // namespace scan_detail
+
+// 在[begin, end)中查找第一个等于value的字节, 找不到时返回end
+inline const uint8_t* findByte(const uint8_t* begin, const uint8_t* end, uint8_t value) {
+    static const scan_detail::FindByteFn impl = scan_detail::selectFindByte();
+    return impl(begin, end, value);
+}
+
+// 按行遍历文本, 与std::getline的规则相同: 最后一行没有换行符时也会输出, 文件末尾的换行符不产生空行
+// stripCR为true时去掉行尾的\r
+// callback参数为(const char* text, size_t length)
+template <typename Callback>
+void forEachLine(const uint8_t* data, size_t size, bool stripCR, Callback&& callback) {
+    const uint8_t* p = data;
+    const uint8_t* end = data + size;
+    while (p < end) {
+        const uint8_t* lineEnd = findByte(p, end, '\n');
+        const uint8_t* textEnd = lineEnd;
+        if (stripCR && textEnd > p && textEnd[-1] == '\r') {
+            textEnd--;
+        }
+        callback(reinterpret_cast<const char*>(p), static_cast<size_t>(textEnd - p));
+        p = lineEnd < end ? lineEnd + 1 : end;
+    }
+}
@@ -0,0 +1,326 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "byte_order.h"
+#include "file_writer.h"
+#include "mapped_file.h"
+#include "script_cipher.h"
+
+// script.bin等ESC-ARC封包文件的读取
+//
+// 文件结构:
+// - 0x00 - 0x07: 文件头, "ESC-ARC1"或"ESC-ARC2"
+// - 0x08 - 0x0B: 索引加密使用的初始密钥
+// - 0x0C - 0x0F: 文件数量(加密)
+// ESC-ARC1:
+// - 0x10开始: 索引表, 每项0x88字节(加密), 文件名(0x80字节) + 偏移 + 长度
+// ESC-ARC2:
+// - 0x10 - 0x13: 文件名区域长度(加密)
+// - 0x14开始: 索引表, 每项12字节(加密), 文件名偏移 + 偏移 + 长度
+// - 之后: 文件名区域, 以\0结尾的字符串
+//
+// 文件内容可能使用LZW压缩, 压缩后的数据以"acp\0"开头, 之后是大端序的解压后长度
+
+struct ArchiveEntry {
+    std::string name;
+    uint32_t offset;
+    uint32_t size;
+};
+
+class ScriptArchive {
+public:
+    // 映射封包文件并解析索引
+    void open(const std::string& path) {
+        if (!file_.open(path)) {
+            throw std::runtime_error("Cannot open archive file: " + path);
+        }
+        const uint8_t* data = file_.data();
+        size_t size = file_.size();
+        if (size < 0x10 || std::memcmp(data, "ESC-ARC", 7) != 0 || (data[7] != '1' && data[7] != '2')) {
+            throw std::runtime_error("Invalid script archive: " + path);
+        }
+
+        version_ = data[7] - '0';
+        seed_ = readLittleEndian32(data + 0x08);
+        ArchiveKeyStream keys(seed_);
+        uint32_t count = readLittleEndian32(data + 0x0C) ^ keys.next();
+
+        entries_.clear();
+        entries_.reserve(count);
+        if (version_ == 1) {
+            size_t indexSize = static_cast<size_t>(count) * 0x88;
+            if (indexSize > size - 0x10) {
+                throw std::runtime_error("Invalid script archive index: " + path);
+            }
+            std::vector<uint8_t> index(data + 0x10, data + 0x10 + indexSize);
+            keys.apply(index.data(), index.size());
+            for (uint32_t i = 0; i < count; i++) {
+                const uint8_t* item = index.data() + i * 0x88;
+                ArchiveEntry entry;
+                entry.name.assign(reinterpret_cast<const char*>(item), strnlen(reinterpret_cast<const char*>(item), 0x80));
+                entry.offset = readLittleEndian32(item + 0x80);
+                entry.size = readLittleEndian32(item + 0x84);
+                entries_.push_back(std::move(entry));
+            }
+        } else {
+            if (size < 0x14) {
+                throw std::runtime_error("Invalid script archive index: " + path);
+            }
+            namesSize_ = readLittleEndian32(data + 0x10) ^ keys.next();
+            size_t indexSize = static_cast<size_t>(count) * 12;
+            if (indexSize > size - 0x14 || namesSize_ > size - 0x14 - indexSize) {
+                throw std::runtime_error("Invalid script archive index: " + path);
+            }
+            std::vector<uint8_t> index(data + 0x14, data + 0x14 + indexSize);
+            keys.apply(index.data(), index.size());
+            const char* names = reinterpret_cast<const char*>(data + 0x14 + indexSize);
+            for (uint32_t i = 0; i < count; i++) {
+                const uint8_t* item = index.data() + i * 12;
+                uint32_t nameOffset = readLittleEndian32(item);
+                if (nameOffset >= namesSize_) {
+                    throw std::runtime_error("Invalid script archive index: " + path);
+                }
+                ArchiveEntry entry;
+                entry.name.assign(names + nameOffset, strnlen(names + nameOffset, namesSize_ - nameOffset));
+                entry.offset = readLittleEndian32(item + 4);
+                entry.size = readLittleEndian32(item + 8);
+                entries_.push_back(std::move(entry));
+            }
+        }
+
+        for (const auto& entry : entries_) {
+            if (entry.offset > size || entry.size > size - entry.offset) {
+                throw std::runtime_error("Archive entry out of range: " + entry.name);
+            }
+        }
+    }
+
+    const std::vector<ArchiveEntry>& entries() const { return entries_; }
+    int version() const { return version_; }
+    uint32_t seed() const { return seed_; }
+    uint32_t namesSize() const { return namesSize_; }
+
+    // 封包中保存的原始数据(可能是压缩数据)
+    const uint8_t* rawData(const ArchiveEntry& entry) const {
+        return file_.data() + entry.offset;
+    }
+
+    static bool isCompressed(const uint8_t* data, size_t size) {
+        return size >= 8 && std::memcmp(data, "acp\0", 4) == 0;
+    }
+
+    // 获取文件内容, 未压缩的文件直接指向封包映射, 压缩的文件解压到buffer中
+    // buffer由调用者持有, 可以在多个文件之间重复使用
+    const uint8_t* entryData(const ArchiveEntry& entry, std::vector<uint8_t>& buffer, size_t& size) const {
+        PhaseTimer timer(StatPhase::Read);
+        const uint8_t* raw = rawData(entry);
+        if (!isCompressed(raw, entry.size)) {
+            size = entry.size;
+            return raw;
+        }
+        unpackLzw(raw, entry.size, buffer);
+        size = buffer.size();
+        return buffer.data();
+    }
+
+private:
+    // LZW解压
+    // 码字为高位在前的变长编码, 初始9位
+    // 0x100: 结束, 0x101: 码字长度加1, 0x102: 重置字典, 0x103开始: 字典项
+    // 字典记录每个码字输出的起始位置, 字典项的内容为该码字的输出加上下一个码字输出的第一个字节
+    static void unpackLzw(const uint8_t* data, size_t size, std::vector<uint8_t>& output) {
+        uint32_t unpackedSize = (data[4] << 24) | (data[5] << 16) | (data[6] << 8) | data[7];
+        output.resize(unpackedSize);
+
+        std::vector<uint32_t> dict(0x8900);
+        size_t dictPos = 0;
+        int tokenWidth = 9;
+        size_t bitPos = 8 * 8;
+        size_t bitEnd = size * 8;
+        size_t dst = 0;
+
+        while (dst < unpackedSize) {
+            if (bitPos + tokenWidth > bitEnd) {
+                throw std::runtime_error("Unexpected end of compressed data");
+            }
+            uint32_t token = 0;
+            for (int i = 0; i < tokenWidth; i++, bitPos++) {
+                token = (token << 1) | ((data[bitPos >> 3] >> (7 - (bitPos & 7))) & 1);
+            }
+
+            if (token == 0x100) {
+                break;
+            } else if (token == 0x101) {
+                if (++tokenWidth > 24) {
+                    throw std::runtime_error("Invalid compressed data");
+                }
+            } else if (token == 0x102) {
+                tokenWidth = 9;
+                dictPos = 0;
+            } else {
+                if (dictPos >= dict.size()) {
+                    throw std::runtime_error("Invalid compressed data");
+                }
+                dict[dictPos++] = static_cast<uint32_t>(dst);
+                if (token < 0x100) {
+                    output[dst++] = static_cast<uint8_t>(token);
+                } else {
+                    token -= 0x103;
+                    if (token + 1 >= dictPos) {
+                        throw std::runtime_error("Invalid compressed data");
+                    }
+                    size_t src = dict[token];
+                    size_t count = std::min<size_t>(unpackedSize - dst, dict[token + 1] - src + 1);
+                    // 源和目标可能重叠, 必须逐字节复制
+                    for (size_t i = 0; i < count; i++) {
+                        output[dst + i] = output[src + i];
+                    }
+                    dst += count;
+                }
+            }
+        }
+        output.resize(dst);
+    }
+
+    MappedFile file_;
+    std::vector<ArchiveEntry> entries_;
+    int version_ = 0;
+    uint32_t seed_ = 0;
+    uint32_t namesSize_ = 0;
+};
+
+// 流式写出新的ESC-ARC封包
+// 文件数量和文件名在开始时确定, 先预留索引区域, 文件内容按顺序写出, 最后回填加密后的索引
+class ArchiveWriter {
+public:
+    ArchiveWriter() = default;
+    ArchiveWriter(const ArchiveWriter&) = delete;
+    ArchiveWriter& operator=(const ArchiveWriter&) = delete;
+
+    ~ArchiveWriter() {
+        if (fd_ >= 0) {
+            ::close(fd_);
+            std::remove(tempPath_.c_str());
+        }
+    }
+
+    void open(const std::string& path, int version, uint32_t seed, const std::vector<std::string>& names) {
+        path_ = path;
+        tempPath_ = path + ".tmp";
+        version_ = version;
+        seed_ = seed;
+        names_ = names;
+        offsets_.clear();
+        sizes_.clear();
+
+        namesSize_ = 0;
+        for (const auto& name : names_) {
+            if (version_ == 1 && name.size() >= 0x80) {
+                throw std::runtime_error("Archive entry name too long: " + name);
+            }
+            namesSize_ += name.size() + 1;
+        }
+        headerSize_ = version_ == 1 ? 0x10 + names_.size() * 0x88 : 0x14 + names_.size() * 12 + namesSize_;
+
+        fd_ = ::open(tempPath_.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd_ < 0) {
+            throw std::runtime_error("Cannot create archive file: " + path);
+        }
+        if (lseek(fd_, static_cast<off_t>(headerSize_), SEEK_SET) < 0) {
+            throw std::runtime_error("Cannot write archive file: " + path);
+        }
+        position_ = headerSize_;
+    }
+
+    // 按索引顺序追加一个文件, 内容可以由多个不连续的内存块组成
+    void append(const struct iovec* parts, int count) {
+        struct iovec iov[4];
+        if (count > 4) {
+            throw std::runtime_error("Too many parts for archive entry");
+        }
+        size_t size = 0;
+        for (int i = 0; i < count; i++) {
+            iov[i] = parts[i];
+            size += parts[i].iov_len;
+        }
+        if (position_ + size > UINT32_MAX) {
+            throw std::runtime_error("Archive too large: " + path_);
+        }
+        if (!writevFully(fd_, iov, count)) {
+            throw std::runtime_error("Cannot write archive file: " + path_);
+        }
+        offsets_.push_back(static_cast<uint32_t>(position_));
+        sizes_.push_back(static_cast<uint32_t>(size));
+        position_ += size;
+    }
+
+    void append(const uint8_t* data, size_t size) {
+        struct iovec part = {const_cast<uint8_t*>(data), size};
+        append(&part, 1);
+    }
+
+    // 写入索引并替换目标文件
+    void finish() {
+        if (offsets_.size() != names_.size()) {
+            throw std::runtime_error("Archive entry count mismatch: " + path_);
+        }
+
+        std::vector<uint8_t> header(headerSize_);
+        ArchiveKeyStream keys(seed_);
+        std::memcpy(header.data(), version_ == 1 ? "ESC-ARC1" : "ESC-ARC2", 8);
+        writeLittleEndian32(header.data() + 0x08, seed_);
+        writeLittleEndian32(header.data() + 0x0C, static_cast<uint32_t>(names_.size()) ^ keys.next());
+
+        if (version_ == 1) {
+            uint8_t* index = header.data() + 0x10;
+            for (size_t i = 0; i < names_.size(); i++) {
+                uint8_t* item = index + i * 0x88;
+                std::memcpy(item, names_[i].data(), names_[i].size());
+                writeLittleEndian32(item + 0x80, offsets_[i]);
+                writeLittleEndian32(item + 0x84, sizes_[i]);
+            }
+            keys.apply(index, names_.size() * 0x88);
+        } else {
+            writeLittleEndian32(header.data() + 0x10, namesSize_ ^ keys.next());
+            uint8_t* index = header.data() + 0x14;
+            char* names = reinterpret_cast<char*>(index + names_.size() * 12);
+            uint32_t nameOffset = 0;
+            for (size_t i = 0; i < names_.size(); i++) {
+                uint8_t* item = index + i * 12;
+                writeLittleEndian32(item, nameOffset);
+                writeLittleEndian32(item + 4, offsets_[i]);
+                writeLittleEndian32(item + 8, sizes_[i]);
+                std::memcpy(names + nameOffset, names_[i].c_str(), names_[i].size() + 1);
+                nameOffset += names_[i].size() + 1;
+            }
+            keys.apply(index, names_.size() * 12);
+        }
+
+        bool ok = pwriteFully(fd_, header.data(), header.size(), 0);
+        if (::close(fd_) != 0) ok = false;
+        fd_ = -1;
+        if (!ok || std::rename(tempPath_.c_str(), path_.c_str()) != 0) {
+            std::remove(tempPath_.c_str());
+            throw std::runtime_error("Cannot write archive file: " + path_);
+        }
+    }
+
+private:
+    std::string path_;
+    std::string tempPath_;
+    int fd_ = -1;
+    int version_ = 2;
+    uint32_t seed_ = 0;
+    std::vector<std::string> names_;
+    uint32_t namesSize_ = 0;
+    size_t headerSize_ = 0;
+    size_t position_ = 0;
+    std::vector<uint32_t> offsets_;
+    std::vector<uint32_t> sizes_;
+};
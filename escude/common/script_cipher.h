@@ -0,0 +1,208 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "byte_order.h"
+#include "file_writer.h"
+#include "scan_kernels.h"
+
+// 封包索引和.001脚本使用的密钥流
+// 每次生成一个32位密钥, 按4字节小端序与数据异或, 不足4字节的尾部不加密; 加密和解密相同
+//
+// 生成函数f(s) = L(s ^ 0x65AC9365), L(x) = x ^ x>>3 ^ x>>4 ^ x<<3 ^ x<<4是GF(2)上的线性变换,
+// 所以f的多次复合也是仿射变换, 可以用4张256项的表一步计算. x86上支持AVX2时每个通道保存一个连续的密钥,
+// 用gather查表同时前进16步, 一次处理64字节; 否则逐个生成
+
+namespace key_stream_detail {
+
+constexpr uint32_t keyConstant = 0x65AC9365;
+constexpr size_t lanes = 8;
+
+inline uint32_t nextKey(uint32_t seed) {
+    seed ^= keyConstant;
+    seed ^= (((seed >> 1) ^ seed) >> 3) ^ (((seed << 1) ^ seed) << 3);
+    return seed;
+}
+
+inline uint32_t applyScalar(uint32_t seed, const uint8_t* in, uint8_t* out, size_t size) {
+    for (size_t i = 0; i + 4 <= size; i += 4) {
+        seed = nextKey(seed);
+        writeLittleEndian32(out + i, readLittleEndian32(in + i) ^ seed);
+    }
+    return seed;
+}
+
+#ifdef ESCUDE_SCAN_X86
+// f的jump次复合: table[0][s & 0xFF] ^ table[1][(s >> 8) & 0xFF] ^ table[2][(s >> 16) & 0xFF] ^ table[3][s >> 24] ^ offset
+struct JumpTable {
+    static constexpr size_t jump = 2 * lanes;
+    uint32_t table[4][256];
+    uint32_t offset;
+
+    JumpTable() {
+        offset = 0;
+        for (size_t k = 0; k < jump; k++) {
+            offset = nextKey(offset);
+        }
+
+        // 线性部分对每一位的作用
+        uint32_t columns[32];
+        for (int bit = 0; bit < 32; bit++) {
+            uint32_t value = 1u << bit;
+            for (size_t k = 0; k < jump; k++) {
+                value = nextKey(value);
+            }
+            columns[bit] = value ^ offset;
+        }
+        for (int b = 0; b < 4; b++) {
+            for (uint32_t v = 0; v < 256; v++) {
+                uint32_t sum = 0;
+                for (int bit = 0; bit < 8; bit++) {
+                    if (v & (1u << bit)) sum ^= columns[b * 8 + bit];
+                }
+                table[b][v] = sum;
+            }
+        }
+    }
+};
+
+__attribute__((target("avx2")))
+inline __m256i jumpAvx2(const JumpTable& jump, __m256i state) {
+    const __m256i byteMask = _mm256_set1_epi32(0xFF);
+    const int* t0 = reinterpret_cast<const int*>(jump.table[0]);
+    const int* t1 = reinterpret_cast<const int*>(jump.table[1]);
+    const int* t2 = reinterpret_cast<const int*>(jump.table[2]);
+    const int* t3 = reinterpret_cast<const int*>(jump.table[3]);
+    __m256i next = _mm256_xor_si256(_mm256_i32gather_epi32(t0, _mm256_and_si256(state, byteMask), 4),
+                                    _mm256_i32gather_epi32(t1, _mm256_and_si256(_mm256_srli_epi32(state, 8), byteMask), 4));
+    next = _mm256_xor_si256(next, _mm256_i32gather_epi32(t2, _mm256_and_si256(_mm256_srli_epi32(state, 16), byteMask), 4));
+    next = _mm256_xor_si256(next, _mm256_i32gather_epi32(t3, _mm256_srli_epi32(state, 24), 4));
+    return _mm256_xor_si256(next, _mm256_set1_epi32(static_cast<int>(jump.offset)));
+}
+
+// 两组通道保存连续的16个密钥, 每轮处理64字节; 两组的查表互不依赖, 可以同时进行
+__attribute__((target("avx2")))
+inline uint32_t applyAvx2(uint32_t seed, const uint8_t* in, uint8_t* out, size_t size) {
+    constexpr size_t blockSize = JumpTable::jump * 4;
+    if (size < blockSize) return applyScalar(seed, in, out, size);
+
+    static const JumpTable jump;
+    alignas(32) uint32_t keys[JumpTable::jump];
+    for (size_t k = 0; k < JumpTable::jump; k++) {
+        seed = nextKey(seed);
+        keys[k] = seed;
+    }
+
+    // x86为小端序, 每个通道的密钥正好对应数据中的4个字节
+    __m256i low = _mm256_load_si256(reinterpret_cast<const __m256i*>(keys));
+    __m256i high = _mm256_load_si256(reinterpret_cast<const __m256i*>(keys + lanes));
+    size_t pos = 0;
+    for (; pos + blockSize <= size; pos += blockSize) {
+        __m256i first = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + pos));
+        __m256i second = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + pos + 32));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + pos), _mm256_xor_si256(first, low));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + pos + 32), _mm256_xor_si256(second, high));
+        seed = static_cast<uint32_t>(_mm256_extract_epi32(high, 7));
+        low = jumpAvx2(jump, low);
+        high = jumpAvx2(jump, high);
+    }
+
+    // 剩余不足一轮的完整4字节继续使用下一轮的密钥; 返回最后使用的密钥, 与逐个生成时的状态相同
+    _mm256_store_si256(reinterpret_cast<__m256i*>(keys), low);
+    _mm256_store_si256(reinterpret_cast<__m256i*>(keys + lanes), high);
+    for (size_t k = 0; pos + 4 <= size; pos += 4, k++) {
+        seed = keys[k];
+        writeLittleEndian32(out + pos, readLittleEndian32(in + pos) ^ seed);
+    }
+    return seed;
+}
+#endif
+
+using ApplyFn = uint32_t (*)(uint32_t, const uint8_t*, uint8_t*, size_t);
+
+inline ApplyFn selectApply() {
+#ifdef ESCUDE_SCAN_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) return applyAvx2;
+#endif
+    return applyScalar;
+}
+
+} // namespace key_stream_detail
+
+// 从seed之后的密钥开始, 把in的完整4字节与密钥流异或后写入out(可以与in相同), 尾部原样复制; 返回最后使用的密钥
+inline uint32_t applyKeyStream(uint32_t seed, const uint8_t* in, uint8_t* out, size_t size) {
+    static const key_stream_detail::ApplyFn impl = key_stream_detail::selectApply();
+    seed = impl(seed, in, out, size);
+    size_t tail = size % 4;
+    if (tail > 0 && in != out) {
+        std::memcpy(out + size - tail, in + size - tail, tail);
+    }
+    return seed;
+}
+
+class ArchiveKeyStream {
+public:
+    explicit ArchiveKeyStream(uint32_t seed) : seed_(seed) {}
+
+    uint32_t next() {
+        seed_ = key_stream_detail::nextKey(seed_);
+        return seed_;
+    }
+
+    void apply(uint8_t* data, size_t size) {
+        seed_ = applyKeyStream(seed_, data, data, size);
+    }
+
+private:
+    uint32_t seed_;
+};
+
+// 加密的脚本(.001文件)
+// - 0x00 - 0x03: 初始密钥
+// - 0x04开始: 使用上面的密钥流加密的脚本(ESCR1_00或@escu:de), 长度与原脚本相同
+// 解密在读入的内存上原地进行, 重建后按原来的初始密钥重新加密
+namespace encrypted_script {
+
+constexpr size_t headerSize = 4;
+constexpr const char* extension = ".001";
+
+inline bool isEncryptedPath(const std::string& path) {
+    return path.size() >= 4 && path.compare(path.size() - 4, 4, extension) == 0;
+}
+
+// 解密data中的脚本并写入out(可以是data + headerSize, 即原地解密), 返回初始密钥; out的长度为size - headerSize
+inline uint32_t decrypt(const uint8_t* data, size_t size, uint8_t* out) {
+    if (size < headerSize) {
+        throw std::runtime_error("Encrypted script is too small");
+    }
+    uint32_t seed = readLittleEndian32(data);
+    applyKeyStream(seed, data + headerSize, out, size - headerSize);
+    return seed;
+}
+
+// 把重建的脚本加密, 加上初始密钥后替换image的内容
+// 新内容写入线程自己的缓冲区再与image.buffer交换, 两个缓冲区在文件之间重复使用
+inline void encrypt(uint32_t seed, ScriptImage& image) {
+    thread_local std::vector<uint8_t> encrypted;
+    encrypted.resize(headerSize + image.size());
+    writeLittleEndian32(encrypted.data(), seed);
+    uint8_t* pos = encrypted.data() + headerSize;
+    for (int i = 0; i < image.partCount; i++) {
+        std::memcpy(pos, image.parts[i].iov_base, image.parts[i].iov_len);
+        pos += image.parts[i].iov_len;
+    }
+    applyKeyStream(seed, encrypted.data() + headerSize, encrypted.data() + headerSize, encrypted.size() - headerSize);
+
+    image.buffer.swap(encrypted);
+    image.parts[0].iov_base = image.buffer.data();
+    image.parts[0].iov_len = image.buffer.size();
+    image.partCount = 1;
+}
+
+} // namespace encrypted_script
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "file_writer.h"
+#include "text_codec.h"
+
+// 文件中的字节范围[offset, offset + length)
+struct ByteRange {
+    size_t offset;
+    size_t length;
+};
+
+// 重建脚本的选项
+struct BuildOptions {
+    bool poolStrings = false; // 合并相同的字符串和后缀, 见StringPool
+};
+
+// 脚本格式接口
+// script.bin中混有多种格式的脚本, 每种格式实现识别, 提取和重建, 由前端根据文件头选择
+class ScriptFormat {
+public:
+    // 遍历字符串时的回调, 参数为(文本段编号, 文本)
+    using StringVisitor = std::function<void(uint32_t segment, std::string_view text)>;
+
+    virtual ~ScriptFormat() = default;
+
+    // 格式名称, 用于输出统计信息
+    virtual const char* name() const = 0;
+
+    // 检查文件头是否属于此格式
+    virtual bool matches(const uint8_t* data, size_t size) const = 0;
+
+    // 提取文本, txt文件的内容追加到output; 没有可提取的文本时返回false, 调用者不创建输出文件
+    virtual bool extractText(const uint8_t* data, size_t size, std::string& output, const TextConversion& conversion) const = 0;
+
+    // 按重建时的顺序遍历所有字符串, 与buildModifiedScript的newTexts一一对应
+    // 空字符串和偏移无效的字符串也会输出(文本为空), 文本直接指向data; 没有可提取的文本时返回false
+    virtual bool forEachString(const uint8_t* data, size_t size, const StringVisitor& visit) const = 0;
+
+    // 使用新文本构建修改后的脚本, 未修改的部分由image直接引用data
+    // newTexts可以直接指向映射的txt文件, 调用期间必须保持有效
+    virtual void buildModifiedScript(const uint8_t* data, size_t size, const std::vector<std::string_view>& newTexts,
+                                     const BuildOptions& options, ScriptImage& image, std::ostream& log) const = 0;
+
+    // 不包含文本的部分(字节码或控制部分, 以及文件头中与文本无关的字段), 按在文件中的顺序
+    // 修改文本时这些部分的内容不变, 只是位置可能移动; 生成差分补丁时直接引用原文件中的这些部分
+    virtual std::vector<ByteRange> fixedRanges(const uint8_t* data, size_t size) const = 0;
+
+    // 读取txt文件时是否去掉行尾的\r
+    virtual bool stripsCarriageReturn() const = 0;
+};
+
+// 根据文件头选择格式, 没有匹配的格式时返回nullptr
+inline const ScriptFormat* detectScriptFormat(const std::vector<const ScriptFormat*>& formats, const uint8_t* data, size_t size) {
+    for (const ScriptFormat* format : formats) {
+        if (format->matches(data, size)) return format;
+    }
+    return nullptr;
+}
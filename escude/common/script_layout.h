@@ -0,0 +1,117 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+
+#include "byte_order.h"
+#include "string_pool.h"
+#include "text_codec.h"
+
+// 脚本布局描述
+// 每种脚本变体用一个描述类型给出文件头字段的位置, 文本段数量, 索引表和数据区域的排列方式;
+// 提取和重建的循环按描述类型和选项在编译期实例化, 每个文件只在入口处选择一次, 循环内部不再判断布局和选项.
+// 支持新的脚本版本时增加描述类型即可
+
+// ESCR1_00: 文件头"ESCR1_00"和字符串数量, 索引表, 字节码长度和字节码, 文本段长度和文本段
+// 只有一个文本段, 索引表在字节码之前, 数据区域在文件末尾
+struct Escr1_00Layout {
+    static constexpr char magic[] = "ESCR1_00";
+    static constexpr size_t countField = 0x08; // 字符串数量(包括固定的空字符串)
+    static constexpr size_t indexTable = 0x0C;
+    static constexpr size_t segmentCount = 1;
+    static constexpr size_t reservedStrings = 1; // 文本段开头固定的空字符串, 提取和重建的文本中不包括
+    static constexpr std::string_view lineEnd = "\r\n";
+};
+
+// @escu:de: 文件头0x1C字节, 控制部分, 文本段; 文本段由文件末尾向前推算
+// 第一个文本段的索引表从控制部分之后到它的数据区域为止, 之后的文本段由文件头记录字符串数量
+struct EscudeScriptHeader {
+    static constexpr uint8_t magic[] = {0x40, 0x65, 0x73, 0x63, 0x75, 0x3A, 0x64, 0x65}; // @escu:de
+    static constexpr size_t headerSize = 0x1C;
+    static constexpr size_t controlLengthField = 0x08;
+    static constexpr size_t segmentsField = 0x0C;  // 值为1时有两个文本段
+    static constexpr size_t lastCountField = 0x14; // 最后一个文本段的字符串数量
+    static constexpr size_t reservedStrings = 0;
+    static constexpr std::string_view lineEnd = "\n";
+};
+
+template <size_t Segments>
+struct EscudeScriptLayout;
+
+template <>
+struct EscudeScriptLayout<1> : EscudeScriptHeader {
+    static constexpr size_t segmentCount = 1;
+    static constexpr size_t dataLengthFields[1] = {0x18}; // 各文本段数据区域的长度
+};
+
+template <>
+struct EscudeScriptLayout<2> : EscudeScriptHeader {
+    static constexpr size_t segmentCount = 2;
+    static constexpr size_t dataLengthFields[2] = {0x10, 0x18};
+};
+
+// 把字符串中的非空文本按行追加到output, 换行由布局决定; 返回输出的行数
+template <typename Layout, bool Converts, typename Strings>
+uint64_t appendTextLines(const Strings& strings, std::string& output, TextEncoding scriptEncoding) {
+    uint64_t lineCount = 0;
+    for (std::string_view text : strings) {
+        if (text.empty()) continue;
+        if constexpr (Converts) {
+            decodeToUtf8(scriptEncoding, reinterpret_cast<const uint8_t*>(text.data()), text.size(), output);
+        } else {
+            output.append(text);
+        }
+        output.append(Layout::lineEnd);
+        lineCount++;
+    }
+    return lineCount;
+}
+
+template <typename Layout, typename Strings>
+uint64_t appendTextLines(const Strings& strings, std::string& output, const TextConversion& conversion) {
+    if (conversion.convertsOutput()) {
+        return appendTextLines<Layout, true>(strings, output, conversion.scriptEncoding);
+    }
+    return appendTextLines<Layout, false>(strings, output, conversion.scriptEncoding);
+}
+
+// 重建一个文本段的索引表和数据区域
+// Pooled时数据区域为合并后的字符串池, 索引表可以指向同一个字符串或其他字符串的尾部; 否则字符串按顺序排列
+template <bool Pooled>
+struct SegmentWriter {
+    // 数据区域的长度
+    static size_t measure(const std::string_view* texts, size_t count, StringPool& pool) {
+        if constexpr (Pooled) {
+            return pool.build(texts, count, true);
+        } else {
+            size_t length = 0;
+            for (size_t i = 0; i < count; i++) {
+                length += texts[i].size() + 1;
+            }
+            return length;
+        }
+    }
+
+    // 写出索引表和数据区域, 索引表中的偏移加上base(数据区域在文本段中的位置)
+    static void write(uint8_t* index, uint8_t* data, uint32_t base, const std::string_view* texts, size_t count,
+                      const StringPool& pool) {
+        if constexpr (Pooled) {
+            for (size_t i = 0; i < count; i++) {
+                writeLittleEndian32(index + i * 4, base + static_cast<uint32_t>(pool.offset(i)));
+            }
+            pool.write(data);
+        } else {
+            uint32_t pos = 0;
+            for (size_t i = 0; i < count; i++) {
+                std::string_view text = texts[i];
+                writeLittleEndian32(index + i * 4, base + pos);
+                std::memcpy(data + pos, text.data(), text.size());
+                data[pos + text.size()] = 0; // 字符串结束符
+                pos += text.size() + 1;
+            }
+        }
+    }
+};
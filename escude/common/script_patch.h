@@ -0,0 +1,265 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <sys/uio.h>
+
+#include "byte_order.h"
+#include "file_writer.h"
+#include "mapped_file.h"
+#include "script_format.h"
+#include "xxhash64.h"
+
+// 脚本差分补丁
+// 修改文本不会改变字节码和控制部分, 补丁只保存文本部分的新内容, 其余部分引用原文件;
+// 每个文件由一串操作组成: 复制原文件中的一段, 或写入补丁数据区域中的一段. 原文件和结果都记录XXH64, 应用前后校验
+//
+// 文件结构(小端序), 应用时映射整个文件, 数据区域直接作为写出的内容:
+//   文件头0x20字节: "ESDP0001", 文件数量, 操作数量, 路径区域长度, 数据区域长度, 保留
+//   文件表: 每个文件40字节, 路径偏移, 路径长度, 原文件长度, 结果长度, 原文件XXH64, 结果XXH64, 第一个操作的序号, 操作数量
+//   操作表: 每个操作12字节, 类型(0为复制原文件, 1为写入数据), 偏移(原文件中或数据区域中), 长度
+//   路径区域, 数据区域
+namespace script_patch {
+
+constexpr char magic[] = "ESDP0001";
+constexpr size_t headerSize = 0x20;
+constexpr size_t fileEntrySize = 40;
+constexpr size_t opEntrySize = 12;
+
+enum OpKind : uint32_t {
+    CopySource = 0,
+    WriteData = 1,
+};
+
+struct Op {
+    uint32_t kind;
+    uint32_t offset;
+    uint32_t length;
+};
+
+} // namespace script_patch
+
+// 写入补丁的一个文件, WriteData操作的偏移相对于data
+struct PatchFile {
+    std::string path;
+    uint32_t sourceSize = 0;
+    uint32_t targetSize = 0;
+    uint64_t sourceHash = 0;
+    uint64_t targetHash = 0;
+    std::vector<script_patch::Op> ops;
+    std::string data;
+};
+
+// 比较原文件和修改后的文件生成操作
+// 两个文件的固定部分(ScriptFormat::fixedRanges)必须一一对应且内容相同, 否则返回false;
+// 修改后文件的固定部分复制自原文件, 其余部分写入补丁数据
+inline bool diffScript(const uint8_t* source, size_t sourceSize, const std::vector<ByteRange>& sourceRanges,
+                       const uint8_t* target, size_t targetSize, const std::vector<ByteRange>& targetRanges, PatchFile& patch) {
+    using namespace script_patch;
+    if (sourceRanges.size() != targetRanges.size() || sourceSize > UINT32_MAX || targetSize > UINT32_MAX) {
+        return false;
+    }
+    patch.sourceSize = static_cast<uint32_t>(sourceSize);
+    patch.targetSize = static_cast<uint32_t>(targetSize);
+    patch.sourceHash = XXHash64::hash(source, sourceSize);
+    patch.targetHash = XXHash64::hash(target, targetSize);
+    patch.ops.clear();
+    patch.data.clear();
+
+    auto writeData = [&](size_t begin, size_t end) {
+        if (begin == end) return;
+        patch.ops.push_back({WriteData, static_cast<uint32_t>(patch.data.size()), static_cast<uint32_t>(end - begin)});
+        patch.data.append(reinterpret_cast<const char*>(target + begin), end - begin);
+    };
+
+    size_t pos = 0;
+    for (size_t k = 0; k < targetRanges.size(); k++) {
+        const ByteRange& from = sourceRanges[k];
+        const ByteRange& to = targetRanges[k];
+        if (from.length != to.length || to.offset < pos || from.offset + from.length > sourceSize ||
+            to.offset + to.length > targetSize || std::memcmp(source + from.offset, target + to.offset, to.length) != 0) {
+            return false;
+        }
+        writeData(pos, to.offset);
+        if (to.length > 0) {
+            patch.ops.push_back({CopySource, static_cast<uint32_t>(from.offset), static_cast<uint32_t>(to.length)});
+        }
+        pos = to.offset + to.length;
+    }
+    writeData(pos, targetSize);
+    return true;
+}
+
+// 写出补丁, 文件按给定的顺序保存
+inline void writeScriptPatch(const std::string& path, const std::vector<PatchFile>& files) {
+    using namespace script_patch;
+    uint64_t opCount = 0;
+    uint64_t pathPoolSize = 0;
+    uint64_t dataSize = 0;
+    for (const PatchFile& file : files) {
+        opCount += file.ops.size();
+        pathPoolSize += file.path.size();
+        dataSize += file.data.size();
+    }
+    if (files.size() > UINT32_MAX || opCount > UINT32_MAX || pathPoolSize > UINT32_MAX || dataSize > UINT32_MAX) {
+        throw std::runtime_error("Patch too large");
+    }
+
+    BufferedSink output;
+    if (!output.open(path)) {
+        throw std::runtime_error("Cannot create output file: " + path);
+    }
+    auto write32 = [&](uint32_t value) {
+        uint8_t bytes[4];
+        writeLittleEndian32(bytes, value);
+        output.write(bytes, 4);
+    };
+    auto write64 = [&](uint64_t value) {
+        uint8_t bytes[8];
+        writeLittleEndian64(bytes, value);
+        output.write(bytes, 8);
+    };
+
+    output.write(magic, 8);
+    write32(static_cast<uint32_t>(files.size()));
+    write32(static_cast<uint32_t>(opCount));
+    write32(static_cast<uint32_t>(pathPoolSize));
+    write32(static_cast<uint32_t>(dataSize));
+    write32(0);
+    write32(0);
+
+    uint32_t pathOffset = 0;
+    uint32_t firstOp = 0;
+    for (const PatchFile& file : files) {
+        write32(pathOffset);
+        write32(static_cast<uint32_t>(file.path.size()));
+        write32(file.sourceSize);
+        write32(file.targetSize);
+        write64(file.sourceHash);
+        write64(file.targetHash);
+        write32(firstOp);
+        write32(static_cast<uint32_t>(file.ops.size()));
+        pathOffset += file.path.size();
+        firstOp += file.ops.size();
+    }
+
+    // 数据偏移转换为整个数据区域中的偏移
+    uint32_t dataBase = 0;
+    for (const PatchFile& file : files) {
+        for (const Op& op : file.ops) {
+            write32(op.kind);
+            write32(op.kind == WriteData ? dataBase + op.offset : op.offset);
+            write32(op.length);
+        }
+        dataBase += file.data.size();
+    }
+    for (const PatchFile& file : files) {
+        output.write(file.path.data(), file.path.size());
+    }
+    for (const PatchFile& file : files) {
+        output.write(file.data.data(), file.data.size());
+    }
+    output.close();
+}
+
+// 读取补丁, 打开时校验所有操作的范围
+class ScriptPatch {
+public:
+    void open(const std::string& path) {
+        using namespace script_patch;
+        if (!file_.open(path)) {
+            throw std::runtime_error("Cannot open patch file: " + path);
+        }
+        const uint8_t* data = file_.data();
+        uint64_t size = file_.size();
+        if (size < headerSize || std::string_view(reinterpret_cast<const char*>(data), 8) != magic) {
+            invalid();
+        }
+
+        fileCount_ = readLittleEndian32(data + 0x08);
+        opCount_ = readLittleEndian32(data + 0x0C);
+        uint32_t pathPoolSize = readLittleEndian32(data + 0x10);
+        uint32_t dataSize = readLittleEndian32(data + 0x14);
+
+        // 各区域必须正好到文件末尾
+        uint64_t filesPos = headerSize;
+        uint64_t opsPos = filesPos + static_cast<uint64_t>(fileCount_) * fileEntrySize;
+        uint64_t pathsPos = opsPos + static_cast<uint64_t>(opCount_) * opEntrySize;
+        uint64_t dataPos = pathsPos + pathPoolSize;
+        if (dataPos + dataSize != size) {
+            invalid();
+        }
+        files_ = data + filesPos;
+        ops_ = data + opsPos;
+        paths_ = reinterpret_cast<const char*>(data + pathsPos);
+        data_ = data + dataPos;
+
+        for (uint32_t i = 0; i < fileCount_; i++) {
+            const uint8_t* entry = fileEntry(i);
+            uint64_t pathEnd = static_cast<uint64_t>(readLittleEndian32(entry)) + readLittleEndian32(entry + 4);
+            uint64_t opEnd = static_cast<uint64_t>(readLittleEndian32(entry + 32)) + readLittleEndian32(entry + 36);
+            if (pathEnd > pathPoolSize || opEnd > opCount_) invalid();
+
+            uint64_t length = 0;
+            for (uint32_t k = 0; k < opCount(i); k++) {
+                Op operation = op(i, k);
+                uint64_t end = static_cast<uint64_t>(operation.offset) + operation.length;
+                if (operation.kind == CopySource ? end > sourceSize(i) : (operation.kind != WriteData || end > dataSize)) {
+                    invalid();
+                }
+                length += operation.length;
+            }
+            if (length != targetSize(i)) invalid();
+        }
+    }
+
+    size_t fileCount() const { return fileCount_; }
+
+    std::string_view path(size_t i) const {
+        const uint8_t* entry = fileEntry(i);
+        return std::string_view(paths_ + readLittleEndian32(entry), readLittleEndian32(entry + 4));
+    }
+
+    uint32_t sourceSize(size_t i) const { return readLittleEndian32(fileEntry(i) + 8); }
+    uint32_t targetSize(size_t i) const { return readLittleEndian32(fileEntry(i) + 12); }
+    uint64_t sourceHash(size_t i) const { return readLittleEndian64(fileEntry(i) + 16); }
+    uint64_t targetHash(size_t i) const { return readLittleEndian64(fileEntry(i) + 24); }
+    uint32_t opCount(size_t i) const { return readLittleEndian32(fileEntry(i) + 36); }
+
+    script_patch::Op op(size_t i, uint32_t k) const {
+        const uint8_t* p = ops_ + (static_cast<size_t>(readLittleEndian32(fileEntry(i) + 32)) + k) * script_patch::opEntrySize;
+        return {readLittleEndian32(p), readLittleEndian32(p + 4), readLittleEndian32(p + 8)};
+    }
+
+    // 组装第i个文件的内容: 每个操作对应一个内存块, 直接引用原文件和补丁的映射内存
+    void gather(size_t i, const uint8_t* source, std::vector<struct iovec>& parts) const {
+        parts.clear();
+        for (uint32_t k = 0; k < opCount(i); k++) {
+            script_patch::Op operation = op(i, k);
+            const uint8_t* base = operation.kind == script_patch::CopySource ? source : data_;
+            parts.push_back({const_cast<uint8_t*>(base + operation.offset), operation.length});
+        }
+    }
+
+private:
+    [[noreturn]] static void invalid() {
+        throw std::runtime_error("Invalid patch file");
+    }
+
+    const uint8_t* fileEntry(size_t i) const {
+        return files_ + i * script_patch::fileEntrySize;
+    }
+
+    MappedFile file_;
+    uint32_t fileCount_ = 0;
+    uint32_t opCount_ = 0;
+    const uint8_t* files_ = nullptr;
+    const uint8_t* ops_ = nullptr;
+    const char* paths_ = nullptr;
+    const uint8_t* data_ = nullptr;
+};
@@ -0,0 +1,1931 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include <poll.h>
+#include <sys/stat.h>
+
+#include "arena.h"
+#include "batch_manifest.h"
+#include "batch_runner.h"
+#include "directory_watcher.h"
+#include "file_writer.h"
+#include "io_pipeline.h"
+#include "mapped_file.h"
+#include "multi_replace.h"
+#include "run_stats.h"
+#include "scan_kernels.h"
+#include "script_archive.h"
+#include "script_cipher.h"
+#include "script_format.h"
+#include "script_patch.h"
+#include "search_index.h"
+#include "text_bundle.h"
+#include "text_codec.h"
+#include "translation_memory.h"
+#include "xxhash64.h"
+
+// 脚本文本工具的命令行前端
+// 支持的格式由各工具传入; 每个文件只打开一次, 根据文件头选择格式后交给对应的实现处理
+struct ScriptToolSettings {
+    std::vector<const ScriptFormat*> formats;
+    bool recursive = true;       // 批量模式是否处理子目录, 输出目录保持相同的结构
+    bool reportsSuccess = false; // 每个文件处理完成后是否输出成功信息
+};
+
+class ScriptTool {
+public:
+    explicit ScriptTool(ScriptToolSettings settings) : settings_(std::move(settings)) {}
+
+    int run(int argc, char* argv[]) {
+        try {
+            if (argc < 4) {
+                printUsage();
+                return 1;
+            }
+
+            std::string mode = argv[1];
+            std::string sourcePath = argv[2];
+            std::string targetPath = argv[3];
+
+            // 封包重建模式和补丁模式需要额外的路径参数
+            int optionStart = 4;
+            std::string outputPath;
+            if (mode == "-ar" || mode == "-pc" || mode == "-pa" || mode == "-dr") {
+                if (argc < 5) {
+                    printUsage();
+                    return 1;
+                }
+                outputPath = argv[4];
+                optionStart = 5;
+            }
+
+            // 解析可选参数
+            for (int i = optionStart; i < argc; i++) {
+                std::string option = argv[i];
+                if (option == "-j" && i + 1 < argc) {
+                    jobs_ = parseJobCount(argv[++i]);
+                } else if (option == "--incremental") {
+                    incremental_ = true;
+                } else if (option == "--out-enc" && i + 1 < argc) {
+                    conversion_.outputEncoding = parseTextEncoding(argv[++i]);
+                } else if (option == "--script-enc" && i + 1 < argc) {
+                    conversion_.scriptEncoding = parseTextEncoding(argv[++i]);
+                    if (conversion_.scriptEncoding != TextEncoding::ShiftJis && conversion_.scriptEncoding != TextEncoding::Gbk) {
+                        throw std::runtime_error("--script-enc only supports sjis or gbk");
+                    }
+                } else if (option == "--in-enc" && i + 1 < argc) {
+                    conversion_.inputEncoding = parseTextEncoding(argv[++i]);
+                } else if (option == "--target" && i + 1 < argc) {
+                    conversion_.targetEncoding = parseTextEncoding(argv[++i]);
+                } else if (option == "--bundle") {
+                    bundle_ = true;
+                } else if (option == "--io-uring") {
+                    ioUring_ = true;
+                } else if (option.compare(0, 16, "--memory-budget=") == 0 && option.size() > 16) {
+                    memoryBudget_ = parseMegabytes(option.substr(16));
+                } else if (option == "--pool-strings") {
+                    buildOptions_.poolStrings = true;
+                } else if (option == "--in-place") {
+                    inPlace_ = true;
+                } else if (option == "--pad") {
+                    padByte_ = 0;
+                } else if (option.compare(0, 6, "--pad=") == 0 && option.size() > 6) {
+                    padByte_ = parsePadByte(option.substr(6));
+                } else if (option.compare(0, 11, "--debounce=") == 0 && option.size() > 11) {
+                    debounceMilliseconds_ = parseMilliseconds(option.substr(11));
+                } else if (option == "--quiet") {
+                    quiet_ = true;
+                } else if (option.compare(0, 8, "--stats=") == 0 && option.size() > 8) {
+                    statsPath_ = option.substr(8);
+                } else {
+                    std::cerr << "Unknown option: " << option << std::endl;
+                    printUsage();
+                    return 1;
+                }
+            }
+            conversion_.validate();
+            if (bundle_ && mode != "-be" && mode != "-bm" && mode != "-ae" && mode != "-ar") {
+                throw std::runtime_error("--bundle is only supported by -be, -bm, -ae and -ar");
+            }
+            if (!statsPath_.empty()) {
+                RunStats::global().enable();
+            }
+
+            if (mode == "-e") {
+                // 提取模式
+                extractText(sourcePath, targetPath);
+            } else if (mode == "-m") {
+                // 修改模式
+                modifyText(sourcePath, targetPath);
+            } else if (mode == "-be") {
+                // 批量提取模式
+                batchExtractText(sourcePath, targetPath);
+            } else if (mode == "-bm") {
+                // 批量修改模式
+                batchModifyText(sourcePath, targetPath);
+            } else if (mode == "-ae") {
+                // 封包提取模式
+                archiveExtractText(sourcePath, targetPath);
+            } else if (mode == "-ar") {
+                // 封包重建模式
+                archiveModifyText(sourcePath, targetPath, outputPath);
+            } else if (mode == "-te") {
+                // 翻译记忆提取模式
+                translationExtract(sourcePath, targetPath);
+            } else if (mode == "-ta") {
+                // 翻译记忆写回模式
+                translationApply(sourcePath, targetPath);
+            } else if (mode == "-ib") {
+                // 生成搜索索引
+                indexBuild(sourcePath, targetPath);
+            } else if (mode == "-is") {
+                // 搜索
+                indexSearch(sourcePath, targetPath);
+            } else if (mode == "-w") {
+                // 监视模式
+                watchText(sourcePath, targetPath);
+            } else if (mode == "-pc") {
+                // 生成差分补丁
+                patchCreate(sourcePath, targetPath, outputPath);
+            } else if (mode == "-pa") {
+                // 应用差分补丁
+                patchApply(sourcePath, targetPath, outputPath);
+            } else if (mode == "-dr") {
+                // 数据文件定长替换
+                dataReplace(sourcePath, targetPath, outputPath);
+            } else {
+                std::cerr << "Invalid operation mode" << std::endl;
+                printUsage();
+                return 1;
+            }
+
+            if (!statsPath_.empty()) {
+                RunStats::global().writeReport(statsPath_, mode, jobs_);
+            }
+            return 0;
+        } catch (const std::exception& e) {
+            std::cerr << "Error: " << e.what() << std::endl;
+            return 1;
+        }
+    }
+
+private:
+    // 根据文件头选择格式
+    // 只支持一种格式时总是交给该格式处理, 由它报告文件头错误; 支持多种格式且都不匹配时返回nullptr
+    const ScriptFormat* resolveFormat(const uint8_t* data, size_t size) const {
+        const ScriptFormat* format = detectScriptFormat(settings_.formats, data, size);
+        if (!format && settings_.formats.size() == 1) {
+            format = settings_.formats.front();
+        }
+        return format;
+    }
+
+    const ScriptFormat& requireFormat(const uint8_t* data, size_t size) const {
+        const ScriptFormat* format = resolveFormat(data, size);
+        if (!format) {
+            throw std::runtime_error("Unknown script format");
+        }
+        return *format;
+    }
+
+    size_t formatIndex(const ScriptFormat* format) const {
+        for (size_t i = 0; i < settings_.formats.size(); i++) {
+            if (settings_.formats[i] == format) return i;
+        }
+        return settings_.formats.size();
+    }
+
+    // 输入文件相对路径对应的输出文件相对路径
+    std::filesystem::path outputPathFor(const std::filesystem::path& relativePath, const std::string& extension) const {
+        std::filesystem::path name = relativePath.stem().string() + extension;
+        return settings_.recursive ? relativePath.parent_path() / name : name;
+    }
+
+    // 收集目录中指定扩展名的文件, 返回相对路径
+    std::vector<std::filesystem::path> collectFiles(const std::string& inputDir, const std::string& extension) const {
+        return collectFiles(inputDir, {extension});
+    }
+
+    std::vector<std::filesystem::path> collectFiles(const std::string& inputDir, std::initializer_list<std::string> extensions) const {
+        namespace fs = std::filesystem;
+        std::vector<fs::path> files;
+        auto visit = [&](const fs::directory_entry& entry) {
+            if (!entry.is_regular_file()) return;
+            std::string extension = entry.path().extension().string();
+            if (std::find(extensions.begin(), extensions.end(), extension) != extensions.end()) {
+                files.push_back(fs::relative(entry.path(), inputDir));
+            }
+        };
+        if (settings_.recursive) {
+            for (const auto& entry : fs::recursive_directory_iterator(inputDir)) visit(entry);
+        } else {
+            for (const auto& entry : fs::directory_iterator(inputDir)) visit(entry);
+        }
+        return files;
+    }
+
+    // 支持多种格式时输出每种格式处理的文件数量
+    void printFormatCounts(const std::vector<size_t>& formatIndices) const {
+        if (settings_.formats.size() <= 1) return;
+        std::vector<int> counts(settings_.formats.size(), 0);
+        for (size_t index : formatIndices) {
+            if (index < counts.size()) counts[index]++;
+        }
+        std::cout << "  ";
+        for (size_t i = 0; i < counts.size(); i++) {
+            std::cout << (i > 0 ? ", " : "") << settings_.formats[i]->name() << ": " << counts[i];
+        }
+        std::cout << std::endl;
+    }
+
+    // 每个线程的修改缓冲区, 在文件之间重复使用, 不随每个文件释放和重新申请
+    struct ModifyBuffers {
+        Arena arena;                        // 转换编码后的文本
+        std::vector<std::string_view> lines; // 指向映射的txt文件或arena
+        std::string converted;
+        ScriptImage image;
+    };
+
+    static ModifyBuffers& modifyBuffers() {
+        thread_local ModifyBuffers buffers;
+        return buffers;
+    }
+
+    // 将txt文件内容按行切分, 需要时转换为写入脚本的编码
+    // 不转换编码时每行直接指向txt文件的内容, 不复制; 返回的行在txt文件内容和下一次调用之前有效
+    const std::vector<std::string_view>& splitTextLines(const uint8_t* data, size_t size, bool stripCR, const std::string& txtFile,
+                                                        std::ostream& warn) const {
+        ModifyBuffers& buffers = modifyBuffers();
+        buffers.arena.reset();
+        buffers.lines.clear();
+        if (!conversion_.convertsInput()) {
+            forEachLine(data, size, stripCR, [&](const char* text, size_t length) {
+                buffers.lines.emplace_back(text, length);
+            });
+            return buffers.lines;
+        }
+
+        // 将UTF-8文本转换为写入脚本的编码
+        size_t bom = utf8BomLength(data, size);
+        forEachLine(data + bom, size - bom, stripCR, [&](const char* text, size_t length) {
+            convertInputLine(conversion_, text, length, buffers.converted, txtFile, buffers.lines.size() + 1, warn);
+            buffers.lines.push_back(buffers.arena.copy(buffers.converted.data(), buffers.converted.size()));
+        });
+        return buffers.lines;
+    }
+
+    // 文本包中一个脚本的字符串, 需要时转换为写入脚本的编码
+    // 不转换编码时直接指向映射的文本包, 不复制; 返回的行在下一次调用之前有效
+    const std::vector<std::string_view>& bundleTexts(const TextBundle& bundle, size_t script, const std::string& source,
+                                                     std::ostream& warn) const {
+        ModifyBuffers& buffers = modifyBuffers();
+        buffers.arena.reset();
+        buffers.lines.clear();
+        for (size_t i = 0; i < bundle.stringCount(script); i++) {
+            std::string_view text = bundle.text(script, i);
+            if (conversion_.convertsInput()) {
+                convertInputLine(conversion_, text.data(), text.size(), buffers.converted, source, i + 1, warn);
+                text = buffers.arena.copy(buffers.converted.data(), buffers.converted.size());
+            }
+            buffers.lines.push_back(text);
+        }
+        return buffers.lines;
+    }
+
+    // 把脚本的全部字符串(包括空字符串)按重建顺序加入文本包, 需要时转换为UTF-8; 没有可提取的文本时返回false
+    bool collectBundleScript(const ScriptFormat& format, const uint8_t* data, size_t size, BundleScript& script) const {
+        std::string converted;
+        PhaseTimer timer(StatPhase::Parse);
+        bool hasText = format.forEachString(data, size, [&](uint32_t, std::string_view text) {
+            if (conversion_.convertsOutput()) {
+                converted.clear();
+                decodeToUtf8(conversion_.scriptEncoding, reinterpret_cast<const uint8_t*>(text.data()), text.size(), converted);
+                text = converted;
+            }
+            script.add(text);
+        });
+        RunStats::addStrings(script.lengths.size());
+        return hasText;
+    }
+
+    // 写出批量提取收集的文本包, 只包含有文本的脚本
+    static void writeCollectedBundle(const std::string& path, std::vector<BundleScript>& scripts, const std::vector<char>& collected) {
+        std::vector<BundleScript> included;
+        for (size_t i = 0; i < scripts.size(); i++) {
+            if (collected[i]) included.push_back(std::move(scripts[i]));
+        }
+        writeTextBundle(path, included);
+    }
+
+    // 增量模式中txt哈希的种子, 影响生成结果的选项改变时所有文件都会重新生成
+    uint64_t textHashSeed() const {
+        return conversion_.hashSeed() | (buildOptions_.poolStrings ? 1ull << 16 : 0);
+    }
+
+    // 提取文本到内存中, 没有可提取的文本时返回false
+    bool extractToString(const ScriptFormat& format, const uint8_t* data, size_t size, std::string& text) const {
+        PhaseTimer timer(StatPhase::Parse);
+        return format.extractText(data, size, text, conversion_);
+    }
+
+    // 读入内存的脚本文件
+    // .001文件解密后data和size为其中的脚本, 重建的结果按原来的初始密钥重新加密
+    struct ScriptContent {
+        const uint8_t* data = nullptr;
+        size_t size = 0;
+        bool encrypted = false;
+        uint32_t seed = 0;
+    };
+
+    // 在读入的内存上原地解密.001文件; 其他文件不变
+    static ScriptContent scriptContent(const std::string& path, uint8_t* data, size_t size) {
+        ScriptContent content{data, size};
+        if (encrypted_script::isEncryptedPath(path)) {
+            decryptContent(content, data + encrypted_script::headerSize);
+        }
+        return content;
+    }
+
+    // 已映射的脚本文件; .001文件需要以写时复制方式打开
+    static ScriptContent scriptContent(const std::string& path, const MappedFile& file) {
+        if (encrypted_script::isEncryptedPath(path)) {
+            return scriptContent(path, file.mutableData(), file.size());
+        }
+        return ScriptContent{file.data(), file.size()};
+    }
+
+    // 封包条目中的脚本: 压缩的条目解压到buffer后原地解密, 未压缩的条目解密到buffer,
+    // 封包的映射保持不变, 重新打包时没有修改的条目仍然原样复制
+    static ScriptContent entryScript(const ScriptArchive& archive, const ArchiveEntry& entry, std::vector<uint8_t>& buffer) {
+        ScriptContent content;
+        content.data = archive.entryData(entry, buffer, content.size);
+        if (encrypted_script::isEncryptedPath(entry.name)) {
+            if (content.data == buffer.data()) {
+                decryptContent(content, buffer.data() + encrypted_script::headerSize);
+            } else {
+                buffer.resize(std::max(content.size, encrypted_script::headerSize) - encrypted_script::headerSize);
+                decryptContent(content, buffer.data());
+            }
+        }
+        return content;
+    }
+
+    // 太短的文件不解密, 之后按未知格式处理
+    static void decryptContent(ScriptContent& content, uint8_t* out) {
+        if (content.size < encrypted_script::headerSize) return;
+        PhaseTimer timer(StatPhase::Read);
+        content.seed = encrypted_script::decrypt(content.data, content.size, out);
+        content.data = out;
+        content.size -= encrypted_script::headerSize;
+        content.encrypted = true;
+    }
+
+    // 使用新文本重建脚本, 结果保存在image中
+    void buildScriptImage(const ScriptFormat& format, const uint8_t* data, size_t size, const std::vector<std::string_view>& newTexts,
+                          ScriptImage& image, std::ostream& log) const {
+        PhaseTimer timer(StatPhase::Parse);
+        format.buildModifiedScript(data, size, newTexts, buildOptions_, image, log);
+        RunStats::addStrings(newTexts.size());
+    }
+
+    // 从内存中的脚本数据提取文本, 返回处理此文件的格式
+    // 文本先在线程自己的缓冲区中生成, 再一次写出
+    const ScriptFormat& extractTextFromMemory(const uint8_t* data, size_t size, const std::string& outputFile, std::ostream& log) const {
+        const ScriptFormat& format = requireFormat(data, size);
+        thread_local std::string text;
+        text.clear();
+        bool extracted = extractToString(format, data, size, text);
+        if (extracted && !writeFileContents(outputFile, text.data(), text.size())) {
+            throw std::runtime_error("Cannot create output file: " + outputFile);
+        }
+        if (extracted && settings_.reportsSuccess && !quiet_) {
+            log << "Text successfully extracted to: " << outputFile << std::endl;
+        }
+        return format;
+    }
+
+    // 使用已映射的txt文件修改已读入的脚本文件, 返回处理此文件的格式
+    const ScriptFormat& modifyMappedScript(const ScriptContent& script, const MappedFile& txt, const std::string& scriptFile,
+                                           const std::string& txtFile, std::ostream& log, std::ostream& warn,
+                                           uint64_t* outputHash) const {
+        const ScriptFormat& format = requireFormat(script.data, script.size);
+        const std::vector<std::string_view>* newTexts;
+        {
+            PhaseTimer timer(StatPhase::Parse);
+            newTexts = &splitTextLines(txt.data(), txt.size(), format.stripsCarriageReturn(), txtFile, warn);
+        }
+        writeModifiedScript(format, script, *newTexts, scriptFile, log, outputHash);
+        return format;
+    }
+
+    // 使用新文本重建已读入的脚本文件并写回
+    void writeModifiedScript(const ScriptFormat& format, const MappedFile& script, const std::vector<std::string_view>& newTexts,
+                             const std::string& scriptFile, std::ostream& log, uint64_t* outputHash) const {
+        writeModifiedScript(format, ScriptContent{script.data(), script.size()}, newTexts, scriptFile, log, outputHash);
+    }
+
+    void writeModifiedScript(const ScriptFormat& format, const ScriptContent& script, const std::vector<std::string_view>& newTexts,
+                             const std::string& scriptFile, std::ostream& log, uint64_t* outputHash) const {
+        ScriptImage& image = modifyBuffers().image;
+        buildScriptImage(format, script.data, script.size, newTexts, image, log);
+        if (script.encrypted) {
+            encrypted_script::encrypt(script.seed, image);
+        }
+
+        // 写入修改后的文件; 原地修改模式下布局不变时只写出变化的部分
+        // 加密的文件已在内存中解密, 不能再与原文件比较, 总是整个写出
+        if (inPlace_ && !script.encrypted && image.canPatchInPlace(script.data)) {
+            if (!image.patchInPlace(scriptFile, script.data, script.size)) {
+                throw std::runtime_error("Cannot write script file: " + scriptFile);
+            }
+        } else if (!image.writeTo(scriptFile)) {
+            throw std::runtime_error("Cannot write script file: " + scriptFile);
+        }
+        if (outputHash) {
+            *outputHash = image.hash();
+        }
+        if (settings_.reportsSuccess && !quiet_) {
+            log << "Script file successfully modified: " << scriptFile << std::endl;
+        }
+    }
+
+    // 从脚本文件中提取文本并保存到txt文件
+    void extractText(const std::string& inputFile, const std::string& outputFile) const {
+        // 映射输入文件, 直接在映射内存上解析; 加密的文件以写时复制方式映射, 原地解密
+        MappedFile file;
+        if (!file.open(inputFile, encrypted_script::isEncryptedPath(inputFile))) {
+            throw std::runtime_error("Cannot open input file: " + inputFile);
+        }
+        ScriptContent script = scriptContent(inputFile, file);
+        extractTextFromMemory(script.data, script.size, outputFile, std::cout);
+        RunStats::global().setFileCounts(1, 0, 0);
+    }
+
+    // 从txt文件读取文本并修改脚本文件
+    void modifyText(const std::string& scriptFile, const std::string& txtFile) const {
+        MappedFile script;
+        if (!script.open(scriptFile, encrypted_script::isEncryptedPath(scriptFile))) {
+            throw std::runtime_error("Cannot open script file: " + scriptFile);
+        }
+        MappedFile txt;
+        if (!txt.open(txtFile)) {
+            throw std::runtime_error("Cannot open text file: " + txtFile);
+        }
+        modifyMappedScript(scriptContent(scriptFile, script), txt, scriptFile, txtFile, std::cout, std::cerr, nullptr);
+        RunStats::global().setFileCounts(1, 0, 0);
+    }
+
+    // 执行批量任务: 指定--io-uring时使用io_uring流水线, 不可用时使用阻塞I/O
+    BatchSummary runPipeline(const std::vector<std::vector<std::string>>& inputPaths, const std::vector<uintmax_t>& weights,
+                             const PipelineTaskFn& task) const {
+        if (ioUring_) {
+            IoUringPipeline pipeline(inputPaths, weights, jobs_, memoryBudget_, task);
+            if (pipeline.init()) {
+                return pipeline.run();
+            }
+            std::cerr << "io_uring is not available, using blocking I/O" << std::endl;
+        }
+        return runBlockingPipeline(inputPaths, weights, jobs_, memoryBudget_, task);
+    }
+
+    // 批量提取目录中的所有bin文件文本
+    // 文本包模式下outputDir是文本包文件, 所有脚本的文本写入同一个文件
+    void batchExtractText(const std::string& inputDir, const std::string& outputDir) const {
+        namespace fs = std::filesystem;
+
+        // 确保输出目录存在
+        if (bundle_) {
+            fs::path parent = fs::path(outputDir).parent_path();
+            if (!parent.empty()) fs::create_directories(parent);
+        } else {
+            fs::create_directories(outputDir);
+        }
+
+        std::vector<std::vector<std::string>> inputPaths;
+        std::vector<std::string> outputPaths;
+        std::vector<std::string> bundleKeys;
+        std::vector<uintmax_t> fileSizes;
+        {
+            PhaseTimer timer(StatPhase::Walk);
+            for (const fs::path& relativePath : collectFiles(inputDir, {".bin", encrypted_script::extension})) {
+                fs::path inputPath = fs::path(inputDir) / relativePath;
+                // 同名的bin文件和加密的脚本都存在时只处理bin文件, 与批量修改时的选择相同
+                if (relativePath.extension() == encrypted_script::extension &&
+                    fs::exists(fs::path(inputPath).replace_extension(".bin"))) {
+                    continue;
+                }
+                if (bundle_) {
+                    // 文本包中的路径与批量修改时脚本的相对路径相同
+                    bundleKeys.push_back(outputPathFor(relativePath, relativePath.extension().string()).generic_string());
+                    outputPaths.push_back(outputDir + ":" + bundleKeys.back());
+                } else {
+                    fs::path outputPath = fs::path(outputDir) / outputPathFor(relativePath, ".txt");
+
+                    // 确保输出文件的目录存在
+                    fs::create_directories(outputPath.parent_path());
+                    outputPaths.push_back(outputPath.string());
+                }
+
+                inputPaths.push_back({inputPath.string()});
+                fileSizes.push_back(fs::file_size(inputPath));
+            }
+        }
+
+        std::vector<BundleScript> bundleScripts(bundle_ ? inputPaths.size() : 0);
+        std::vector<char> collected(bundleScripts.size(), 0);
+        std::vector<size_t> formatIndices(inputPaths.size(), settings_.formats.size());
+        BatchSummary summary = runPipeline(inputPaths, fileSizes, [&](size_t i, std::vector<PipelineInput>& inputs,
+                                                                      PipelineOutput& output, BatchResult& result) {
+            const PipelineInput& input = inputs[0];
+            if (input.error) {
+                result.error = "Error processing " + input.path + ": Cannot open input file: " + input.path + "\n";
+                return;
+            }
+            ScriptContent file = scriptContent(input.path, input.data, input.size);
+            if (!resolveFormat(file.data, file.size)) {
+                result.error = "Skip: Unknown script format: " + input.path + "\n";
+                result.skipped = true;
+                return;
+            }
+
+            std::ostringstream log;
+            if (!quiet_) {
+                log << "Processing: " << input.path << " -> " << outputPaths[i] << std::endl;
+            }
+            try {
+                const ScriptFormat& format = requireFormat(file.data, file.size);
+                if (bundle_) {
+                    bundleScripts[i].path = bundleKeys[i];
+                    collected[i] = collectBundleScript(format, file.data, file.size, bundleScripts[i]);
+                } else if (extractToString(format, file.data, file.size, output.text)) {
+                    output.writeText(outputPaths[i]);
+                    output.failure = "Error processing " + input.path + ": Cannot create output file: " + outputPaths[i];
+                    if (settings_.reportsSuccess && !quiet_) {
+                        output.successLog = "Text successfully extracted to: " + outputPaths[i] + "\n";
+                    }
+                }
+                formatIndices[i] = formatIndex(&format);
+                result.success = true;
+            } catch (const std::exception& e) {
+                result.error = "Error processing " + input.path + ": " + e.what() + "\n";
+            }
+            result.output = log.str();
+        });
+        if (bundle_) {
+            writeCollectedBundle(outputDir, bundleScripts, collected);
+        }
+
+        RunStats::global().setFileCounts(summary.processedCount, summary.errorCount, summary.skippedCount);
+        std::cout << "Batch extraction completed. " << summary.processedCount << " files processed, "
+                  << summary.errorCount << " errors";
+        if (summary.skippedCount > 0) {
+            std::cout << ", " << summary.skippedCount << " skipped";
+        }
+        std::cout << "." << std::endl;
+        printFormatCounts(formatIndices);
+    }
+
+    // 批量修改目录中的所有文本文件对应的bin文件
+    // 文本包模式下inputDir是文本包文件, 修改其中记录的所有脚本
+    void batchModifyText(const std::string& inputDir, const std::string& outputDir) const {
+        namespace fs = std::filesystem;
+
+        // 确保输出目录存在
+        fs::create_directories(outputDir);
+
+        // 每个任务的输入为bin文件和txt文件(文本包模式下只有bin文件)
+        std::vector<std::vector<std::string>> inputPaths;
+        std::vector<std::string> textPaths;
+        std::vector<std::string> outputPaths;
+        std::vector<std::string> manifestKeys;
+        std::vector<uintmax_t> fileSizes;
+        TextBundle bundle;
+        if (bundle_) {
+            bundle.open(inputDir);
+            for (size_t i = 0; i < bundle.scriptCount(); i++) {
+                std::string key(bundle.scriptPath(i));
+                fs::path outputPath = fs::path(outputDir) / key;
+                std::error_code error;
+                uintmax_t scriptSize = fs::file_size(outputPath, error);
+                textPaths.push_back(inputDir + ":" + key);
+                outputPaths.push_back(outputPath.string());
+                inputPaths.push_back({outputPaths.back()});
+                manifestKeys.push_back(key);
+                fileSizes.push_back(bundle.textSize(i) + (error ? 0 : scriptSize));
+            }
+        } else {
+            PhaseTimer timer(StatPhase::Walk);
+            for (const fs::path& relativePath : collectFiles(inputDir, ".txt")) {
+                fs::path inputPath = fs::path(inputDir) / relativePath;
+                fs::path scriptPath = outputPathFor(relativePath, ".bin");
+                fs::path outputPath = fs::path(outputDir) / scriptPath;
+
+                // 没有bin文件时使用同名的加密脚本
+                if (!fs::exists(outputPath)) {
+                    fs::path encryptedPath = outputPathFor(relativePath, encrypted_script::extension);
+                    if (fs::exists(fs::path(outputDir) / encryptedPath)) {
+                        scriptPath = encryptedPath;
+                        outputPath = fs::path(outputDir) / scriptPath;
+                    }
+                }
+
+                // 确保输出文件的目录存在
+                fs::create_directories(outputPath.parent_path());
+
+                std::error_code error;
+                uintmax_t scriptSize = fs::file_size(outputPath, error);
+                textPaths.push_back(inputPath.string());
+                outputPaths.push_back(outputPath.string());
+                inputPaths.push_back({outputPaths.back(), textPaths.back()});
+                manifestKeys.push_back(scriptPath.generic_string());
+                fileSizes.push_back(fs::file_size(inputPath) + (error ? 0 : scriptSize));
+            }
+        }
+
+        // 增量模式: 清单记录上次处理完成时txt文件和bin文件的哈希, 两者都没有变化的文件直接跳过
+        BatchManifest manifest;
+        if (incremental_) {
+            manifest.open((fs::path(outputDir) / ".bm_manifest").string());
+        }
+
+        std::vector<size_t> formatIndices(inputPaths.size(), settings_.formats.size());
+        BatchSummary summary = runPipeline(inputPaths, fileSizes, [&](size_t i, std::vector<PipelineInput>& inputs,
+                                                                      PipelineOutput& output, BatchResult& result) {
+            // 检查输出文件是否存在
+            const PipelineInput& scriptFile = inputs[0];
+            if (scriptFile.error) {
+                result.error = "Skip: Cannot find corresponding bin file: " + outputPaths[i] + "\n";
+                return;
+            }
+            const PipelineInput* txt = bundle_ ? nullptr : &inputs[1];
+            if (txt && txt->error) {
+                result.error = "Error processing " + textPaths[i] + ": Cannot open text file: " + textPaths[i] + "\n";
+                return;
+            }
+
+            // 哈希直接在读入的文件内容上计算, 每个文件只读取一次
+            uint64_t textHash = 0;
+            uint64_t scriptHash = 0;
+            if (incremental_) {
+                textHash = bundle_ ? bundle.hash(i, textHashSeed())
+                                   : XXHash64::hash(txt->data, txt->size, textHashSeed());
+                scriptHash = XXHash64::hash(scriptFile.data, scriptFile.size);
+                if (manifest.isUnchanged(manifestKeys[i], textHash, scriptHash)) {
+                    result.skipped = true;
+                    return;
+                }
+            }
+            ScriptContent script = scriptContent(outputPaths[i], scriptFile.data, scriptFile.size);
+            if (!resolveFormat(script.data, script.size)) {
+                result.error = "Skip: Unknown script format: " + outputPaths[i] + "\n";
+                result.skipped = true;
+                return;
+            }
+
+            std::ostringstream log;
+            std::ostringstream warn;
+            if (!quiet_) {
+                log << "Processing: " << textPaths[i] << " -> " << outputPaths[i] << std::endl;
+            }
+            try {
+                const ScriptFormat& format = requireFormat(script.data, script.size);
+                const std::vector<std::string_view>* newTexts;
+                {
+                    PhaseTimer timer(StatPhase::Parse);
+                    newTexts = bundle_ ? &bundleTexts(bundle, i, textPaths[i], warn)
+                                       : &splitTextLines(txt->data, txt->size, format.stripsCarriageReturn(), textPaths[i], warn);
+                }
+                ScriptImage& image = output.image;
+                buildScriptImage(format, script.data, script.size, *newTexts, image, log);
+                if (script.encrypted) {
+                    encrypted_script::encrypt(script.seed, image);
+                }
+                std::string success;
+                if (settings_.reportsSuccess && !quiet_) {
+                    success = "Script file successfully modified: " + outputPaths[i] + "\n";
+                }
+
+                // 原地修改模式下布局不变时只写出变化的部分, 直接在工作线程中完成; 加密的文件总是整个写出
+                if (inPlace_ && !script.encrypted && image.canPatchInPlace(script.data)) {
+                    if (!image.patchInPlace(outputPaths[i], script.data, script.size)) {
+                        throw std::runtime_error("Cannot write script file: " + outputPaths[i]);
+                    }
+                    log << success;
+                    if (incremental_) {
+                        manifest.record(manifestKeys[i], textHash, image.hash());
+                    }
+                } else {
+                    output.writeImage(outputPaths[i]);
+                    output.failure = "Error processing " + textPaths[i] + ": Cannot write script file: " + outputPaths[i];
+                    output.successLog = success;
+                    if (incremental_) {
+                        uint64_t outputHash = image.hash();
+                        output.onWritten = [&manifest, &manifestKeys, i, textHash, outputHash] {
+                            manifest.record(manifestKeys[i], textHash, outputHash);
+                        };
+                    }
+                }
+                formatIndices[i] = formatIndex(&format);
+                result.success = true;
+            } catch (const std::exception& e) {
+                result.error = "Error processing " + textPaths[i] + ": " + e.what() + "\n";
+            }
+            result.output = log.str();
+            result.error = warn.str() + result.error;
+        });
+
+        RunStats::global().setFileCounts(summary.processedCount, summary.errorCount, summary.skippedCount);
+        std::cout << "Batch modification completed. " << summary.processedCount << " files processed, "
+                  << summary.errorCount << " errors";
+        if (incremental_) {
+            manifest.compact();
+            std::cout << ", " << summary.skippedCount << " unchanged";
+        } else if (summary.skippedCount > 0) {
+            std::cout << ", " << summary.skippedCount << " skipped";
+        }
+        std::cout << "." << std::endl;
+        printFormatCounts(formatIndices);
+    }
+
+    // 从script.bin封包中直接提取所有脚本的文本, 不解包到磁盘
+    // 文本包模式下outputDir是文本包文件, 文本包中的路径为封包中的文件名
+    void archiveExtractText(const std::string& archivePath, const std::string& outputDir) const {
+        namespace fs = std::filesystem;
+
+        ScriptArchive archive;
+        archive.open(archivePath);
+
+        // 确保输出目录存在
+        if (bundle_) {
+            fs::path parent = fs::path(outputDir).parent_path();
+            if (!parent.empty()) fs::create_directories(parent);
+        } else {
+            fs::create_directories(outputDir);
+        }
+
+        const auto& entries = archive.entries();
+        std::vector<std::string> outputPaths;
+        std::vector<uintmax_t> entrySizes;
+        for (const auto& entry : entries) {
+            if (bundle_) {
+                outputPaths.push_back(outputDir + ":" + entry.name);
+            } else {
+                fs::path outputPath = fs::path(outputDir) / outputPathFor(entry.name, ".txt");
+                fs::create_directories(outputPath.parent_path());
+                outputPaths.push_back(outputPath.string());
+            }
+            entrySizes.push_back(entry.size);
+        }
+
+        std::vector<BundleScript> bundleScripts(bundle_ ? entries.size() : 0);
+        std::vector<char> collected(bundleScripts.size(), 0);
+        std::vector<size_t> formatIndices(entries.size(), settings_.formats.size());
+        BatchSummary summary = runBatch(entrySizes, jobs_, memoryBudget_, [&](size_t i, BatchResult& result) {
+            // 压缩的文件解压到线程自己的缓冲区, 缓冲区在文件之间重复使用
+            thread_local std::vector<uint8_t> unpackBuffer;
+            const ArchiveEntry& entry = entries[i];
+            std::ostringstream log;
+            try {
+                ScriptContent script = entryScript(archive, entry, unpackBuffer);
+                const uint8_t* data = script.data;
+                size_t size = script.size;
+                const ScriptFormat* format = detectScriptFormat(settings_.formats, data, size);
+                if (!format) {
+                    result.skipped = true;
+                    return;
+                }
+                if (!quiet_) {
+                    log << "Processing: " << archivePath << ":" << entry.name << " -> " << outputPaths[i] << std::endl;
+                }
+                if (bundle_) {
+                    bundleScripts[i].path = entry.name;
+                    collected[i] = collectBundleScript(*format, data, size, bundleScripts[i]);
+                } else {
+                    extractTextFromMemory(data, size, outputPaths[i], log);
+                }
+                formatIndices[i] = formatIndex(format);
+                result.success = true;
+            } catch (const std::exception& e) {
+                result.error = "Error processing " + archivePath + ":" + entry.name + ": " + e.what() + "\n";
+            }
+            result.output = log.str();
+        });
+        if (bundle_) {
+            writeCollectedBundle(outputDir, bundleScripts, collected);
+        }
+
+        RunStats::global().setFileCounts(summary.processedCount, summary.errorCount, summary.skippedCount);
+        std::cout << "Archive extraction completed. " << summary.processedCount << " files processed, "
+                  << summary.errorCount << " errors, " << summary.skippedCount << " skipped." << std::endl;
+        printFormatCounts(formatIndices);
+    }
+
+    // 使用txt文件修改script.bin封包中的脚本, 直接流式写出新的封包
+    // 文本没有变化或没有对应txt文件的条目原样复制封包中的原始数据
+    // 文本包模式下inputDir是文本包文件, 按封包中的文件名查找对应的文本
+    void archiveModifyText(const std::string& archivePath, const std::string& inputDir, const std::string& outputArchive) const {
+        namespace fs = std::filesystem;
+
+        ScriptArchive archive;
+        archive.open(archivePath);
+        const auto& entries = archive.entries();
+
+        TextBundle bundle;
+        if (bundle_) {
+            bundle.open(inputDir);
+        }
+
+        std::vector<std::string> names;
+        for (const auto& entry : entries) {
+            names.push_back(entry.name);
+        }
+
+        ArchiveWriter writer;
+        writer.open(outputArchive, archive.version(), archive.seed(), names);
+
+        int patchedCount = 0;
+        int copiedCount = 0;
+        int errorCount = 0;
+        std::vector<uint8_t> unpackBuffer;
+
+        ScriptImage& image = modifyBuffers().image;
+        for (const auto& entry : entries) {
+            std::string txtPath;
+            size_t bundleIndex = TextBundle::npos;
+            if (bundle_) {
+                bundleIndex = bundle.find(entry.name);
+                txtPath = inputDir + ":" + entry.name;
+            } else {
+                txtPath = (fs::path(inputDir) / outputPathFor(entry.name, ".txt")).string();
+            }
+            bool patched = false;
+
+            if (bundle_ ? bundleIndex != TextBundle::npos : fs::exists(txtPath)) {
+                try {
+                    ScriptContent script = entryScript(archive, entry, unpackBuffer);
+                    const uint8_t* data = script.data;
+                    size_t size = script.size;
+                    const ScriptFormat* format = detectScriptFormat(settings_.formats, data, size);
+                    if (format) {
+                        MappedFile txt;
+                        if (!bundle_ && !txt.open(txtPath)) {
+                            throw std::runtime_error("Cannot open text file: " + txtPath);
+                        }
+                        std::ostringstream log;
+                        const std::vector<std::string_view>& newTexts =
+                            bundle_ ? bundleTexts(bundle, bundleIndex, txtPath, std::cerr)
+                                    : splitTextLines(txt.data(), txt.size(), format->stripsCarriageReturn(), txtPath, std::cerr);
+                        buildScriptImage(*format, data, size, newTexts, image, log);
+                        patched = !image.equals(data, size);
+                        if (patched && script.encrypted) {
+                            encrypted_script::encrypt(script.seed, image);
+                        }
+                    }
+                } catch (const std::exception& e) {
+                    std::cerr << "Error processing " << archivePath << ":" << entry.name << ": " << e.what() << std::endl;
+                    errorCount++;
+                }
+            }
+
+            if (patched) {
+                if (!quiet_) {
+                    std::cout << "Processing: " << txtPath << " -> " << outputArchive << ":" << entry.name << std::endl;
+                }
+                writer.append(image.parts, image.partCount);
+                patchedCount++;
+            } else {
+                writer.append(archive.rawData(entry), entry.size);
+                copiedCount++;
+            }
+        }
+
+        writer.finish();
+        RunStats::global().setFileCounts(patchedCount, errorCount, copiedCount);
+
+        std::cout << "Archive repack completed. " << patchedCount << " files patched, " << copiedCount
+                  << " files copied, " << errorCount << " errors." << std::endl;
+    }
+
+    // 提取目录中所有脚本的字符串, 去重后写入翻译记忆目录
+    // 各文件的字符串在工作线程中复制并计算哈希; 去重在全部文件处理完成后按路径顺序进行, 字符串ID与线程数无关
+    void translationExtract(const std::string& inputDir, const std::string& memoryDir) const {
+        namespace fs = std::filesystem;
+        using translation_memory::Occurrence;
+
+        // 确保输出目录存在
+        fs::create_directories(memoryDir);
+
+        std::vector<fs::path> relativePaths;
+        std::vector<uintmax_t> fileSizes;
+        {
+            PhaseTimer timer(StatPhase::Walk);
+            relativePaths = collectFiles(inputDir, ".bin");
+            std::sort(relativePaths.begin(), relativePaths.end());
+            for (const fs::path& relativePath : relativePaths) {
+                fileSizes.push_back(fs::file_size(fs::path(inputDir) / relativePath));
+            }
+        }
+
+        // 一个文件中的非空字符串, 文本复制到pool中
+        struct StringRef {
+            uint32_t segment;
+            uint32_t index;
+            uint32_t offset;
+            uint32_t length;
+            uint64_t hash;
+        };
+        struct FileStrings {
+            bool hasText = false;
+            std::vector<uint32_t> segmentSizes;
+            std::string pool;
+            std::vector<StringRef> strings;
+        };
+        std::vector<FileStrings> fileStrings(relativePaths.size());
+
+        std::vector<size_t> formatIndices(relativePaths.size(), settings_.formats.size());
+        BatchSummary summary = runBatch(fileSizes, jobs_, memoryBudget_, [&](size_t i, BatchResult& result) {
+            std::string inputPath = (fs::path(inputDir) / relativePaths[i]).string();
+            MappedFile file;
+            if (!file.open(inputPath)) {
+                result.error = "Error processing " + inputPath + ": Cannot open input file: " + inputPath + "\n";
+                return;
+            }
+            if (!resolveFormat(file.data(), file.size())) {
+                result.error = "Skip: Unknown script format: " + inputPath + "\n";
+                result.skipped = true;
+                return;
+            }
+
+            std::ostringstream log;
+            if (!quiet_) {
+                log << "Processing: " << inputPath << std::endl;
+            }
+            try {
+                const ScriptFormat& format = requireFormat(file.data(), file.size());
+                FileStrings& strings = fileStrings[i];
+                PhaseTimer timer(StatPhase::Parse);
+                strings.hasText = format.forEachString(file.data(), file.size(), [&](uint32_t segment, std::string_view text) {
+                    if (segment >= strings.segmentSizes.size()) {
+                        strings.segmentSizes.resize(segment + 1, 0);
+                    }
+                    uint32_t index = strings.segmentSizes[segment]++;
+                    if (text.empty()) return;
+                    strings.strings.push_back({segment, index, static_cast<uint32_t>(strings.pool.size()),
+                                               static_cast<uint32_t>(text.size()), StringInterner::hash(text)});
+                    strings.pool.append(text);
+                });
+                formatIndices[i] = formatIndex(&format);
+                result.success = true;
+            } catch (const std::exception& e) {
+                fileStrings[i] = FileStrings();
+                result.error = "Error processing " + inputPath + ": " + e.what() + "\n";
+            }
+            result.output = log.str();
+        });
+
+        // 按文件顺序去重, 记录每次出现的字符串ID和位置
+        StringInterner interner;
+        std::vector<translation_memory::FileRecord> files;
+        std::vector<uint32_t> ids;
+        std::vector<Occurrence> positions;
+        {
+            PhaseTimer timer(StatPhase::Parse);
+            for (size_t i = 0; i < fileStrings.size(); i++) {
+                const FileStrings& strings = fileStrings[i];
+                if (!strings.hasText) continue;
+                uint32_t fileNumber = static_cast<uint32_t>(files.size());
+                files.push_back({relativePaths[i].generic_string(), strings.segmentSizes});
+                for (const StringRef& ref : strings.strings) {
+                    ids.push_back(interner.intern(std::string_view(strings.pool.data() + ref.offset, ref.length), ref.hash));
+                    positions.push_back({fileNumber, ref.segment, ref.index});
+                }
+            }
+            if (ids.size() > UINT32_MAX) {
+                throw std::runtime_error("Too many strings");
+            }
+        }
+
+        // 出现位置按字符串ID分组(计数排序), 同一字符串的出现位置保持文件顺序
+        std::vector<uint32_t> occurrenceStart(interner.size() + 1, 0);
+        for (uint32_t id : ids) {
+            occurrenceStart[id + 1]++;
+        }
+        for (size_t id = 0; id < interner.size(); id++) {
+            occurrenceStart[id + 1] += occurrenceStart[id];
+        }
+        std::vector<Occurrence> occurrences(ids.size());
+        std::vector<uint32_t> next(occurrenceStart.begin(), occurrenceStart.end() - 1);
+        for (size_t k = 0; k < ids.size(); k++) {
+            occurrences[next[ids[k]]++] = positions[k];
+        }
+
+        // 写出去重后的字符串和出现位置索引
+        std::string stringsPath = (fs::path(memoryDir) / translation_memory::stringsFileName).string();
+        BufferedSink output;
+        if (!output.open(stringsPath)) {
+            throw std::runtime_error("Cannot create output file: " + stringsPath);
+        }
+        std::string converted;
+        for (uint32_t id = 0; id < interner.size(); id++) {
+            std::string_view text = interner.text(id);
+            if (conversion_.convertsOutput()) {
+                converted.clear();
+                decodeToUtf8(conversion_.scriptEncoding, reinterpret_cast<const uint8_t*>(text.data()), text.size(), converted);
+                output.write(converted.data(), converted.size());
+            } else {
+                output.write(text.data(), text.size());
+            }
+            output.put('\n');
+        }
+        output.close();
+        writeTranslationIndex((fs::path(memoryDir) / translation_memory::indexFileName).string(), files, occurrenceStart, occurrences);
+
+        RunStats::addStrings(ids.size());
+        RunStats::global().setFileCounts(summary.processedCount, summary.errorCount, summary.skippedCount);
+        std::cout << "Translation memory extraction completed. " << summary.processedCount << " files processed, "
+                  << summary.errorCount << " errors";
+        if (summary.skippedCount > 0) {
+            std::cout << ", " << summary.skippedCount << " skipped";
+        }
+        std::cout << "." << std::endl;
+        std::cout << "  " << ids.size() << " strings, " << interner.size() << " unique." << std::endl;
+        printFormatCounts(formatIndices);
+    }
+
+    // 为目录中全部脚本的字符串生成全文搜索索引
+    // 文本按--script-enc转换为UTF-8后建立索引, 空字符串不加入索引
+    void indexBuild(const std::string& inputDir, const std::string& indexPath) const {
+        namespace fs = std::filesystem;
+
+        fs::path parent = fs::path(indexPath).parent_path();
+        if (!parent.empty()) fs::create_directories(parent);
+
+        std::vector<fs::path> relativePaths;
+        std::vector<uintmax_t> fileSizes;
+        {
+            PhaseTimer timer(StatPhase::Walk);
+            relativePaths = collectFiles(inputDir, ".bin");
+            std::sort(relativePaths.begin(), relativePaths.end());
+            for (const fs::path& relativePath : relativePaths) {
+                fileSizes.push_back(fs::file_size(fs::path(inputDir) / relativePath));
+            }
+        }
+
+        // 一个文件中的非空字符串, UTF-8文本依次保存在pool中
+        struct StringRef {
+            uint32_t segment;
+            uint32_t index;
+            uint32_t length;
+        };
+        struct FileStrings {
+            bool hasText = false;
+            std::string pool;
+            std::vector<StringRef> strings;
+        };
+        std::vector<FileStrings> fileStrings(relativePaths.size());
+
+        std::vector<size_t> formatIndices(relativePaths.size(), settings_.formats.size());
+        BatchSummary summary = runBatch(fileSizes, jobs_, memoryBudget_, [&](size_t i, BatchResult& result) {
+            std::string inputPath = (fs::path(inputDir) / relativePaths[i]).string();
+            MappedFile file;
+            if (!file.open(inputPath)) {
+                result.error = "Error processing " + inputPath + ": Cannot open input file: " + inputPath + "\n";
+                return;
+            }
+            if (!resolveFormat(file.data(), file.size())) {
+                result.error = "Skip: Unknown script format: " + inputPath + "\n";
+                result.skipped = true;
+                return;
+            }
+
+            std::ostringstream log;
+            if (!quiet_) {
+                log << "Processing: " << inputPath << std::endl;
+            }
+            try {
+                const ScriptFormat& format = requireFormat(file.data(), file.size());
+                FileStrings& strings = fileStrings[i];
+                std::vector<uint32_t> segmentSizes;
+                PhaseTimer timer(StatPhase::Parse);
+                strings.hasText = format.forEachString(file.data(), file.size(), [&](uint32_t segment, std::string_view text) {
+                    if (segment >= segmentSizes.size()) {
+                        segmentSizes.resize(segment + 1, 0);
+                    }
+                    uint32_t index = segmentSizes[segment]++;
+                    if (text.empty()) return;
+                    size_t start = strings.pool.size();
+                    decodeToUtf8(conversion_.scriptEncoding, reinterpret_cast<const uint8_t*>(text.data()), text.size(), strings.pool);
+                    strings.strings.push_back({segment, index, static_cast<uint32_t>(strings.pool.size() - start)});
+                });
+                formatIndices[i] = formatIndex(&format);
+                result.success = true;
+            } catch (const std::exception& e) {
+                fileStrings[i] = FileStrings();
+                result.error = "Error processing " + inputPath + ": " + e.what() + "\n";
+            }
+            result.output = log.str();
+        });
+
+        // 按路径顺序加入索引, 每个文件的数据加入后立即释放
+        SearchIndexBuilder builder;
+        size_t gramCount;
+        {
+            PhaseTimer timer(StatPhase::Parse);
+            for (size_t i = 0; i < fileStrings.size(); i++) {
+                FileStrings& strings = fileStrings[i];
+                if (!strings.hasText) continue;
+                builder.addFile(relativePaths[i].generic_string());
+                size_t offset = 0;
+                for (const StringRef& ref : strings.strings) {
+                    builder.addString(ref.segment, ref.index, std::string_view(strings.pool.data() + offset, ref.length));
+                    offset += ref.length;
+                }
+                strings = FileStrings();
+            }
+            gramCount = builder.write(indexPath);
+        }
+
+        RunStats::addStrings(builder.stringCount());
+        RunStats::global().setFileCounts(summary.processedCount, summary.errorCount, summary.skippedCount);
+        std::cout << "Search index build completed. " << summary.processedCount << " files processed, "
+                  << summary.errorCount << " errors";
+        if (summary.skippedCount > 0) {
+            std::cout << ", " << summary.skippedCount << " skipped";
+        }
+        std::cout << "." << std::endl;
+        std::cout << "  " << builder.stringCount() << " strings, " << gramCount << " n-grams." << std::endl;
+        printFormatCounts(formatIndices);
+    }
+
+    // 在搜索索引中查找包含query(UTF-8)的字符串, 每个结果输出为 路径:文本段:序号: 文本
+    void indexSearch(const std::string& indexPath, const std::string& query) const {
+        auto start = std::chrono::steady_clock::now();
+        SearchIndex index;
+        index.open(indexPath);
+
+        std::vector<uint32_t> results;
+        index.search(query, results);
+        double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+        std::string output;
+        for (uint32_t id : results) {
+            output.append(index.filePath(index.stringFile(id)));
+            output.append(":" + std::to_string(index.stringSegment(id)) + ":" + std::to_string(index.stringIndex(id)) + ": ");
+            output.append(index.text(id));
+            output.push_back('\n');
+        }
+        std::cout.write(output.data(), output.size());
+        std::cout << results.size() << " matches in " << index.stringCount() << " strings (" << milliseconds << " ms)." << std::endl;
+    }
+
+    // 监视模式: 保存txt文件后立即重建对应的bin文件
+    // 启动时映射所有脚本并识别格式, 常驻内存; txt文件写入完成后等待debounce时间内没有新的写入再重建,
+    // txt内容与上次重建时相同则跳过. 脚本目录中的bin文件被其他程序修改时重新映射;
+    // 映射时记录文件的inode, 大小和修改时间, 本工具写出产生的事件与记录相同, 不会导致重新映射
+    void watchText(const std::string& textDir, const std::string& scriptDir) const {
+        namespace fs = std::filesystem;
+        using Clock = std::chrono::steady_clock;
+
+        // 一个脚本的常驻状态, 以bin文件相对路径为键
+        struct WatchedScript {
+            const ScriptFormat* format = nullptr;
+            MappedFile script;
+            bool stale = true;      // bin文件需要重新映射
+            struct stat mapped{};   // 映射时bin文件的状态
+            uint64_t textHash = 0;  // 上次重建时txt文件的哈希
+            bool built = false;
+        };
+        std::unordered_map<std::string, WatchedScript> scripts;
+
+        // 映射bin文件并识别格式, 失败时抛出异常
+        auto load = [&](const std::string& key, WatchedScript& entry) {
+            std::string scriptPath = (fs::path(scriptDir) / key).string();
+            if (!entry.script.open(scriptPath)) {
+                throw std::runtime_error("Cannot find corresponding bin file: " + scriptPath);
+            }
+            entry.format = &requireFormat(entry.script.data(), entry.script.size());
+            if (stat(scriptPath.c_str(), &entry.mapped) != 0) {
+                throw std::runtime_error("Cannot stat bin file: " + scriptPath);
+            }
+            entry.stale = false;
+        };
+
+        // bin文件是否仍是映射时的文件
+        auto unchanged = [&](const std::string& key, const WatchedScript& entry) {
+            struct stat current;
+            if (stat((fs::path(scriptDir) / key).c_str(), &current) != 0) return false;
+            return current.st_dev == entry.mapped.st_dev && current.st_ino == entry.mapped.st_ino &&
+                   current.st_size == entry.mapped.st_size &&
+                   current.st_mtim.tv_sec == entry.mapped.st_mtim.tv_sec &&
+                   current.st_mtim.tv_nsec == entry.mapped.st_mtim.tv_nsec;
+        };
+
+        size_t textCount = 0;
+        for (const fs::path& relativePath : collectFiles(textDir, ".txt")) {
+            std::string key = outputPathFor(relativePath, ".bin").generic_string();
+            try {
+                load(key, scripts[key]);
+                textCount++;
+            } catch (const std::exception& e) {
+                scripts.erase(key);
+                std::cerr << "Skip: " << (fs::path(textDir) / relativePath).string() << ": " << e.what() << std::endl;
+            }
+        }
+
+        DirectoryWatcher watcher;
+        if (!watcher.open()) {
+            throw std::runtime_error("Cannot create inotify instance");
+        }
+        int textTree = watcher.addTree(textDir);
+        int scriptTree = watcher.addTree(scriptDir);
+        std::cout << "Watching " << textCount << " text files in " << textDir << " (scripts in " << scriptDir
+                  << "). Press Ctrl+C to stop." << std::endl;
+
+        // 等待重建的txt文件: 第一次写入的时间和最后一次写入的时间
+        struct PendingChange {
+            Clock::time_point first;
+            Clock::time_point last;
+        };
+        std::unordered_map<std::string, PendingChange> pending;
+        auto debounce = std::chrono::milliseconds(debounceMilliseconds_);
+
+        auto rebuild = [&](const std::string& textKey, Clock::time_point saved) {
+            std::string key = outputPathFor(fs::path(textKey), ".bin").generic_string();
+            std::string textPath = (fs::path(textDir) / textKey).string();
+            std::string scriptPath = (fs::path(scriptDir) / key).string();
+            Clock::time_point start = Clock::now();
+            try {
+                WatchedScript& entry = scripts[key];
+                if (entry.stale) {
+                    load(key, entry);
+                }
+                MappedFile txt;
+                if (!txt.open(textPath)) {
+                    throw std::runtime_error("Cannot open text file: " + textPath);
+                }
+                uint64_t textHash = XXHash64::hash(txt.data(), txt.size(), textHashSeed());
+                if (entry.built && textHash == entry.textHash) {
+                    if (!quiet_) {
+                        std::cout << "Unchanged: " << textPath << std::endl;
+                    }
+                    return;
+                }
+
+                std::ostringstream log;
+                const std::vector<std::string_view>* newTexts;
+                {
+                    PhaseTimer timer(StatPhase::Parse);
+                    newTexts = &splitTextLines(txt.data(), txt.size(), entry.format->stripsCarriageReturn(), textPath, std::cerr);
+                }
+                writeModifiedScript(*entry.format, entry.script, *newTexts, scriptPath, log, nullptr);
+
+                // 重新映射写出的文件, 下次重建(包括原地修改)以它为基础
+                load(key, entry);
+                entry.textHash = textHash;
+                entry.built = true;
+
+                Clock::time_point end = Clock::now();
+                std::cout << "Updated: " << scriptPath << " (rebuild "
+                          << std::chrono::duration<double, std::milli>(end - start).count() << " ms, since save "
+                          << std::chrono::duration<double, std::milli>(end - saved).count() << " ms)" << std::endl;
+            } catch (const std::exception& e) {
+                scripts.erase(key);
+                std::cerr << "Error processing " << textPath << ": " << e.what() << std::endl;
+            }
+        };
+
+        while (true) {
+            int timeout = -1;
+            Clock::time_point now = Clock::now();
+            for (const auto& change : pending) {
+                auto wait = std::chrono::ceil<std::chrono::milliseconds>(change.second.last + debounce - now).count();
+                int remaining = static_cast<int>(std::max<long long>(wait, 0));
+                timeout = timeout < 0 ? remaining : std::min(timeout, remaining);
+            }
+
+            struct pollfd entry = {watcher.fd(), POLLIN, 0};
+            if (poll(&entry, 1, timeout) < 0 && errno != EINTR) {
+                throw std::runtime_error("Cannot wait for file changes");
+            }
+
+            now = Clock::now();
+            bool complete = watcher.readEvents([&](int tree, const std::string& path) {
+                fs::path relativePath(path);
+                if (!settings_.recursive && relativePath.has_parent_path()) return;
+                if (tree == textTree && relativePath.extension() == ".txt") {
+                    auto inserted = pending.insert({path, {now, now}});
+                    inserted.first->second.last = now;
+                } else if (tree == scriptTree && relativePath.extension() == ".bin") {
+                    auto it = scripts.find(path);
+                    if (it != scripts.end() && !it->second.stale && !unchanged(path, it->second)) it->second.stale = true;
+                }
+            });
+            if (!complete) {
+                std::cerr << "Warning: file change events were lost, save the file again to rebuild it" << std::endl;
+            }
+
+            for (auto it = pending.begin(); it != pending.end();) {
+                if (now - it->second.last >= debounce) {
+                    rebuild(it->first, it->second.first);
+                    it = pending.erase(it);
+                } else {
+                    ++it;
+                }
+            }
+        }
+    }
+
+    // 比较原脚本目录和修改后的脚本目录, 生成只包含文本部分的差分补丁
+    // 与原文件完全相同的文件不写入补丁
+    void patchCreate(const std::string& originalDir, const std::string& modifiedDir, const std::string& patchPath) const {
+        namespace fs = std::filesystem;
+
+        fs::path parent = fs::path(patchPath).parent_path();
+        if (!parent.empty()) fs::create_directories(parent);
+
+        std::vector<fs::path> relativePaths;
+        std::vector<uintmax_t> fileSizes;
+        {
+            PhaseTimer timer(StatPhase::Walk);
+            relativePaths = collectFiles(modifiedDir, ".bin");
+            std::sort(relativePaths.begin(), relativePaths.end());
+            for (const fs::path& relativePath : relativePaths) {
+                fileSizes.push_back(fs::file_size(fs::path(modifiedDir) / relativePath));
+            }
+        }
+
+        std::vector<PatchFile> patches(relativePaths.size());
+        std::vector<char> changed(relativePaths.size(), 0);
+        std::vector<size_t> formatIndices(relativePaths.size(), settings_.formats.size());
+        BatchSummary summary = runBatch(fileSizes, jobs_, memoryBudget_, [&](size_t i, BatchResult& result) {
+            std::string originalPath = (fs::path(originalDir) / relativePaths[i]).string();
+            std::string modifiedPath = (fs::path(modifiedDir) / relativePaths[i]).string();
+            MappedFile modified;
+            if (!modified.open(modifiedPath)) {
+                result.error = "Error processing " + modifiedPath + ": Cannot open input file: " + modifiedPath + "\n";
+                return;
+            }
+            MappedFile original;
+            if (!original.open(originalPath)) {
+                result.error = "Skip: Cannot find original file: " + originalPath + "\n";
+                return;
+            }
+            if (!resolveFormat(modified.data(), modified.size())) {
+                result.error = "Skip: Unknown script format: " + modifiedPath + "\n";
+                result.skipped = true;
+                return;
+            }
+
+            std::ostringstream log;
+            try {
+                const ScriptFormat& format = requireFormat(modified.data(), modified.size());
+                if (original.size() == modified.size() && std::memcmp(original.data(), modified.data(), modified.size()) == 0) {
+                    result.skipped = true;
+                    return;
+                }
+                if (!quiet_) {
+                    log << "Processing: " << originalPath << " -> " << modifiedPath << std::endl;
+                }
+                if (!format.matches(original.data(), original.size())) {
+                    throw std::runtime_error("Script format differs from original: " + originalPath);
+                }
+                PhaseTimer timer(StatPhase::Parse);
+                PatchFile& patch = patches[i];
+                patch.path = relativePaths[i].generic_string();
+                if (!diffScript(original.data(), original.size(), format.fixedRanges(original.data(), original.size()),
+                                modified.data(), modified.size(), format.fixedRanges(modified.data(), modified.size()), patch)) {
+                    throw std::runtime_error("Script code differs from original: " + originalPath);
+                }
+                changed[i] = 1;
+                formatIndices[i] = formatIndex(&format);
+                result.success = true;
+            } catch (const std::exception& e) {
+                patches[i] = PatchFile();
+                result.error = "Error processing " + modifiedPath + ": " + e.what() + "\n";
+            }
+            result.output = log.str();
+        });
+
+        // 按路径顺序写出有变化的文件
+        std::vector<PatchFile> files;
+        size_t dataSize = 0;
+        for (size_t i = 0; i < patches.size(); i++) {
+            if (!changed[i]) continue;
+            dataSize += patches[i].data.size();
+            files.push_back(std::move(patches[i]));
+        }
+        writeScriptPatch(patchPath, files);
+
+        RunStats::global().setFileCounts(summary.processedCount, summary.errorCount, summary.skippedCount);
+        std::cout << "Patch creation completed. " << summary.processedCount << " files processed, "
+                  << summary.errorCount << " errors";
+        if (summary.skippedCount > 0) {
+            std::cout << ", " << summary.skippedCount << " unchanged or skipped";
+        }
+        std::cout << "." << std::endl;
+        std::cout << "  " << files.size() << " files patched, " << dataSize << " bytes of text data." << std::endl;
+        printFormatCounts(formatIndices);
+    }
+
+    // 使用原脚本和差分补丁生成修改后的脚本
+    // 原文件的XXH64必须与补丁记录的一致; 写出的内容直接引用原文件和补丁的映射内存, 写出前校验结果的XXH64
+    void patchApply(const std::string& originalDir, const std::string& patchPath, const std::string& outputDir) const {
+        namespace fs = std::filesystem;
+
+        ScriptPatch patch;
+        patch.open(patchPath);
+
+        std::vector<std::string> originalPaths;
+        std::vector<std::string> outputPaths;
+        std::vector<uintmax_t> fileSizes;
+        for (size_t i = 0; i < patch.fileCount(); i++) {
+            fs::path relativePath = fs::path(std::string(patch.path(i))).lexically_normal();
+            if (relativePath.empty() || relativePath.is_absolute() || *relativePath.begin() == "..") {
+                throw std::runtime_error("Invalid path in patch file: " + relativePath.string());
+            }
+            fs::path outputPath = fs::path(outputDir) / relativePath;
+            fs::create_directories(outputPath.parent_path());
+            originalPaths.push_back((fs::path(originalDir) / relativePath).string());
+            outputPaths.push_back(outputPath.string());
+            fileSizes.push_back(patch.targetSize(i));
+        }
+
+        BatchSummary summary = runBatch(fileSizes, jobs_, memoryBudget_, [&](size_t i, BatchResult& result) {
+            MappedFile original;
+            if (!original.open(originalPaths[i])) {
+                result.error = "Error processing " + originalPaths[i] + ": Cannot open input file: " + originalPaths[i] + "\n";
+                return;
+            }
+
+            std::ostringstream log;
+            if (!quiet_) {
+                log << "Processing: " << originalPaths[i] << " -> " << outputPaths[i] << std::endl;
+            }
+            try {
+                thread_local std::vector<struct iovec> parts;
+                {
+                    PhaseTimer timer(StatPhase::Parse);
+                    if (original.size() != patch.sourceSize(i) ||
+                        XXHash64::hash(original.data(), original.size()) != patch.sourceHash(i)) {
+                        throw std::runtime_error("Original file does not match the patch");
+                    }
+                    patch.gather(i, original.data(), parts);
+                    XXHash64 hasher;
+                    for (const struct iovec& part : parts) {
+                        hasher.update(part.iov_base, part.iov_len);
+                    }
+                    if (hasher.digest() != patch.targetHash(i)) {
+                        throw std::runtime_error("Patched file checksum mismatch");
+                    }
+                }
+                if (!writeFileGather(outputPaths[i], parts.data(), static_cast<int>(parts.size()))) {
+                    throw std::runtime_error("Cannot write script file: " + outputPaths[i]);
+                }
+                result.success = true;
+            } catch (const std::exception& e) {
+                result.error = "Error processing " + originalPaths[i] + ": " + e.what() + "\n";
+            }
+            result.output = log.str();
+        });
+
+        RunStats::global().setFileCounts(summary.processedCount, summary.errorCount, summary.skippedCount);
+        std::cout << "Patch application completed. " << summary.processedCount << " files processed, "
+                  << summary.errorCount << " errors." << std::endl;
+    }
+
+    // 使用翻译记忆修改目录中的脚本, 每个字符串的译文写回到它出现的所有位置
+    void translationApply(const std::string& memoryDir, const std::string& scriptDir) const {
+        namespace fs = std::filesystem;
+
+        TranslationIndex index;
+        index.open((fs::path(memoryDir) / translation_memory::indexFileName).string());
+        const auto& files = index.files();
+
+        // 译文在主线程中切分和转换编码; 复制行列表, 工作线程使用自己的缓冲区组装每个文件的文本
+        std::string stringsPath = (fs::path(memoryDir) / translation_memory::stringsFileName).string();
+        MappedFile stringsFile;
+        if (!stringsFile.open(stringsPath)) {
+            throw std::runtime_error("Cannot open text file: " + stringsPath);
+        }
+        std::vector<std::string_view> translations;
+        {
+            PhaseTimer timer(StatPhase::Parse);
+            translations = splitTextLines(stringsFile.data(), stringsFile.size(), true, stringsPath, std::cerr);
+        }
+        if (translations.size() != index.stringCount()) {
+            throw std::runtime_error("String count mismatch in " + stringsPath + ". Expected: " +
+                                     std::to_string(index.stringCount()) + ", Got: " + std::to_string(translations.size()));
+        }
+
+        // 展开出现位置: 所有文件的字符串按文件依次排列, 每个位置记录字符串ID, 空字符串的位置没有ID
+        constexpr uint32_t noString = UINT32_MAX;
+        std::vector<size_t> fileStart(files.size() + 1, 0);
+        std::vector<std::vector<size_t>> segmentStart(files.size());
+        for (size_t i = 0; i < files.size(); i++) {
+            size_t position = fileStart[i];
+            for (uint32_t size : files[i].segmentSizes) {
+                segmentStart[i].push_back(position);
+                position += size;
+            }
+            fileStart[i + 1] = position;
+        }
+        std::vector<uint32_t> stringIds(fileStart.back(), noString);
+        {
+            PhaseTimer timer(StatPhase::Parse);
+            for (uint32_t id = 0; id < index.stringCount(); id++) {
+                for (uint32_t k = index.occurrenceStart(id); k < index.occurrenceStart(id + 1); k++) {
+                    translation_memory::Occurrence occurrence = index.occurrence(k);
+                    stringIds[segmentStart[occurrence.file][occurrence.segment] + occurrence.index] = id;
+                }
+            }
+        }
+
+        std::vector<uintmax_t> weights;
+        for (size_t i = 0; i < files.size(); i++) {
+            weights.push_back(fileStart[i + 1] - fileStart[i]);
+        }
+
+        std::vector<size_t> formatIndices(files.size(), settings_.formats.size());
+        BatchSummary summary = runBatch(weights, jobs_, memoryBudget_, [&](size_t i, BatchResult& result) {
+            std::string scriptPath = (fs::path(scriptDir) / files[i].path).string();
+            MappedFile script;
+            if (!script.open(scriptPath)) {
+                result.error = "Skip: Cannot find corresponding bin file: " + scriptPath + "\n";
+                return;
+            }
+            if (!resolveFormat(script.data(), script.size())) {
+                result.error = "Skip: Unknown script format: " + scriptPath + "\n";
+                result.skipped = true;
+                return;
+            }
+
+            std::ostringstream log;
+            if (!quiet_) {
+                log << "Processing: " << memoryDir << " -> " << scriptPath << std::endl;
+            }
+            try {
+                const ScriptFormat& format = requireFormat(script.data(), script.size());
+                std::vector<std::string_view>& newTexts = modifyBuffers().lines;
+                newTexts.clear();
+                for (size_t position = fileStart[i]; position < fileStart[i + 1]; position++) {
+                    uint32_t id = stringIds[position];
+                    newTexts.push_back(id == noString ? std::string_view() : translations[id]);
+                }
+                writeModifiedScript(format, script, newTexts, scriptPath, log, nullptr);
+                formatIndices[i] = formatIndex(&format);
+                result.success = true;
+            } catch (const std::exception& e) {
+                result.error = "Error processing " + scriptPath + ": " + e.what() + "\n";
+            }
+            result.output = log.str();
+        });
+
+        RunStats::global().setFileCounts(summary.processedCount, summary.errorCount, summary.skippedCount);
+        std::cout << "Translation memory applied. " << summary.processedCount << " files processed, "
+                  << summary.errorCount << " errors";
+        if (summary.skippedCount > 0) {
+            std::cout << ", " << summary.skippedCount << " skipped";
+        }
+        std::cout << "." << std::endl;
+        printFormatCounts(formatIndices);
+    }
+
+    // 数据文件替换的映射: 原文和译文已转换为数据文件中的编码, 长度相同
+    struct DataMapping {
+        ReplaceAutomaton automaton;
+        std::vector<std::string> replacements; // 按模式编号
+        std::vector<size_t> lineNumbers;       // 模式在映射文件中的行号
+        std::vector<std::string> originals;    // 映射文件中的原文, 用于报告
+    };
+
+    // 映射文件中的一个字段转换为数据文件中的编码; 无法编码的字符返回false
+    static bool encodeMappingField(TextEncoding to, std::string_view text, std::string& out) {
+        out.clear();
+        if (to != TextEncoding::ShiftJis && to != TextEncoding::Gbk) {
+            out.assign(text);
+            return true;
+        }
+        std::vector<uint32_t> failed;
+        PhaseTimer timer(StatPhase::Transcode);
+        encodeFromUtf8(to, reinterpret_cast<const uint8_t*>(text.data()), text.size(), out, failed);
+        return failed.empty();
+    }
+
+    // 读取映射文件: 每行为"原文<Tab>译文", 空行忽略
+    // 使用--in-enc utf8时原文转换为--script-enc, 译文转换为--target; 否则按原始字节处理
+    // 所有行检查完成后一起报告错误: 缺少Tab, 原文为空, 原文重复, 无法编码, 译文比原文长(或没有--pad时比原文短)
+    DataMapping loadDataMapping(const std::string& mappingPath) const {
+        MappedFile file;
+        if (!file.open(mappingPath)) {
+            throw std::runtime_error("Cannot open mapping file: " + mappingPath);
+        }
+        bool converts = conversion_.convertsInput();
+        size_t bom = converts ? utf8BomLength(file.data(), file.size()) : 0;
+
+        DataMapping mapping;
+        std::unordered_map<std::string, size_t> seen;
+        std::string original;
+        std::string translated;
+        size_t lineNumber = 0;
+        size_t errorCount = 0;
+        auto error = [&](const std::string& message) {
+            std::cerr << "Error: " << mappingPath << ":" << lineNumber << ": " << message << std::endl;
+            errorCount++;
+        };
+        PhaseTimer timer(StatPhase::Parse);
+        forEachLine(file.data() + bom, file.size() - bom, true, [&](const char* text, size_t length) {
+            lineNumber++;
+            if (length == 0) return;
+            std::string_view line(text, length);
+            size_t tab = line.find('\t');
+            if (tab == std::string_view::npos) {
+                error("missing tab between original and translation");
+                return;
+            }
+            std::string_view originalText = line.substr(0, tab);
+            if (originalText.empty()) {
+                error("empty original text");
+                return;
+            }
+            if (!encodeMappingField(converts ? conversion_.scriptEncoding : TextEncoding::Raw, originalText, original) ||
+                !encodeMappingField(converts ? conversion_.targetEncoding : TextEncoding::Raw, line.substr(tab + 1), translated)) {
+                error("cannot encode the text");
+                return;
+            }
+            auto inserted = seen.emplace(original, lineNumber);
+            if (!inserted.second) {
+                error("duplicate of line " + std::to_string(inserted.first->second));
+                return;
+            }
+            if (translated.size() > original.size() || (translated.size() < original.size() && padByte_ < 0)) {
+                error("translation is " + std::to_string(translated.size()) + " bytes, original is " +
+                      std::to_string(original.size()) + " bytes");
+                return;
+            }
+            translated.resize(original.size(), static_cast<char>(padByte_));
+            mapping.automaton.add(original);
+            mapping.replacements.push_back(translated);
+            mapping.lineNumbers.push_back(lineNumber);
+            mapping.originals.emplace_back(originalText);
+        });
+        if (errorCount > 0) {
+            throw std::runtime_error("Invalid mapping file: " + mappingPath + " (" + std::to_string(errorCount) + " errors)");
+        }
+        mapping.automaton.build();
+        return mapping;
+    }
+
+    // 按映射文件对data.bin等数据文件做定长替换
+    // 所有原文构建一个自动机, 每个文件只扫描一遍; 选中的位置直接在读入的私有内存上替换后整个写出, --in-place且输出为输入本身时只写出替换的字节
+    // inputPath为目录时处理其中所有bin文件, 输出到outputPath下相同的相对路径; 没有替换的文件不写出
+    void dataReplace(const std::string& mappingPath, const std::string& inputPath, const std::string& outputPath) const {
+        namespace fs = std::filesystem;
+
+        DataMapping mapping = loadDataMapping(mappingPath);
+        const ReplaceAutomaton& automaton = mapping.automaton;
+        std::cout << "Loaded " << automaton.patternCount() << " patterns (" << automaton.stateCount() << " states, "
+                  << automaton.classCount() << " byte classes)." << std::endl;
+
+        std::vector<std::vector<std::string>> inputPaths;
+        std::vector<std::string> outputPaths;
+        std::vector<uintmax_t> fileSizes;
+        {
+            PhaseTimer timer(StatPhase::Walk);
+            if (fs::is_directory(inputPath)) {
+                for (const fs::path& relativePath : collectFiles(inputPath, ".bin")) {
+                    fs::path outputFile = fs::path(outputPath) / relativePath;
+                    fs::create_directories(outputFile.parent_path());
+                    inputPaths.push_back({(fs::path(inputPath) / relativePath).string()});
+                    outputPaths.push_back(outputFile.string());
+                    fileSizes.push_back(fs::file_size(inputPaths.back()[0]));
+                }
+            } else {
+                fs::path parent = fs::path(outputPath).parent_path();
+                if (!parent.empty()) fs::create_directories(parent);
+                inputPaths.push_back({inputPath});
+                outputPaths.push_back(outputPath);
+                std::error_code error;
+                uintmax_t size = fs::file_size(inputPath, error);
+                fileSizes.push_back(error ? 0 : size);
+            }
+        }
+
+        // 每个文件中实际替换的模式和出现过的模式, 全部完成后按文件顺序合并:
+        // 没有替换过的模式报告为未匹配, 其中出现过但每次都包含在更长的匹配中或因冲突放弃的模式另外列出
+        std::vector<std::vector<uint32_t>> applied(inputPaths.size());
+        std::vector<std::vector<uint32_t>> occurred(inputPaths.size());
+        std::vector<size_t> replacedCounts(inputPaths.size(), 0);
+        std::vector<size_t> collisionCounts(inputPaths.size(), 0);
+        BatchSummary summary = runPipeline(inputPaths, fileSizes, [&](size_t i, std::vector<PipelineInput>& inputs,
+                                                                      PipelineOutput& output, BatchResult& result) {
+            const PipelineInput& input = inputs[0];
+            if (input.error) {
+                result.error = "Error processing " + input.path + ": Cannot open input file: " + input.path + "\n";
+                return;
+            }
+
+            thread_local std::vector<ReplaceMatch> matches;
+            thread_local std::vector<ReplaceMatch> selected;
+            thread_local std::vector<std::pair<ReplaceMatch, ReplaceMatch>> collisions;
+            {
+                PhaseTimer timer(StatPhase::Parse);
+                matches.clear();
+                automaton.scan(input.data, input.size, [&](size_t offset, uint32_t pattern) {
+                    matches.push_back({offset, pattern});
+                });
+                auto collect = [](const std::vector<ReplaceMatch>& source, std::vector<uint32_t>& patterns) {
+                    for (const ReplaceMatch& match : source) {
+                        patterns.push_back(match.pattern);
+                    }
+                    std::sort(patterns.begin(), patterns.end());
+                    patterns.erase(std::unique(patterns.begin(), patterns.end()), patterns.end());
+                };
+                collect(matches, occurred[i]);
+                automaton.resolve(matches, selected, collisions);
+                collect(selected, applied[i]);
+            }
+
+            std::ostringstream warn;
+            for (const auto& collision : collisions) {
+                warn << "Collision: " << input.path << ":0x" << std::hex << collision.first.offset << std::dec << ": line "
+                     << mapping.lineNumbers[collision.first.pattern] << " overlaps line "
+                     << mapping.lineNumbers[collision.second.pattern] << " at 0x" << std::hex << collision.second.offset
+                     << std::dec << ", not replaced\n";
+            }
+            result.error = warn.str();
+            collisionCounts[i] = collisions.size();
+            if (selected.empty()) {
+                result.skipped = true;
+                return;
+            }
+
+            std::ostringstream log;
+            if (!quiet_) {
+                log << "Processing: " << input.path << " -> " << outputPaths[i] << " (" << selected.size() << " replacements)" << std::endl;
+            }
+            try {
+                for (const ReplaceMatch& match : selected) {
+                    const std::string& replacement = mapping.replacements[match.pattern];
+                    std::memcpy(input.data + match.offset, replacement.data(), replacement.size());
+                }
+                std::error_code error;
+                if (inPlace_ && fs::equivalent(input.path, outputPaths[i], error)) {
+                    // 长度不变, 只写出替换的字节
+                    PhaseTimer timer(StatPhase::Write);
+                    int fd = ::open(outputPaths[i].c_str(), O_WRONLY);
+                    bool ok = fd >= 0;
+                    for (size_t k = 0; ok && k < selected.size(); k++) {
+                        size_t length = automaton.patternLength(selected[k].pattern);
+                        ok = pwriteFully(fd, input.data + selected[k].offset, length, static_cast<off_t>(selected[k].offset));
+                    }
+                    if (fd >= 0 && ::close(fd) != 0) ok = false;
+                    if (!ok) {
+                        throw std::runtime_error("Cannot write data file: " + outputPaths[i]);
+                    }
+                } else {
+                    output.path = outputPaths[i];
+                    output.parts.push_back({input.data, input.size});
+                    output.replace = true;
+                    output.failure = "Error processing " + input.path + ": Cannot write data file: " + outputPaths[i];
+                }
+                replacedCounts[i] = selected.size();
+                result.success = true;
+            } catch (const std::exception& e) {
+                result.error += "Error processing " + input.path + ": " + e.what() + "\n";
+            }
+            result.output = log.str();
+        });
+
+        std::vector<bool> replaced(automaton.patternCount(), false);
+        std::vector<bool> found(automaton.patternCount(), false);
+        size_t replacedCount = 0;
+        size_t collisionCount = 0;
+        for (size_t i = 0; i < inputPaths.size(); i++) {
+            for (uint32_t pattern : applied[i]) replaced[pattern] = true;
+            for (uint32_t pattern : occurred[i]) found[pattern] = true;
+            replacedCount += replacedCounts[i];
+            collisionCount += collisionCounts[i];
+        }
+        size_t unmatchedCount = 0;
+        size_t shadowedCount = 0;
+        for (uint32_t pattern = 0; pattern < replaced.size(); pattern++) {
+            if (replaced[pattern]) continue;
+            std::cerr << "Unmatched: " << mappingPath << ":" << mapping.lineNumbers[pattern] << ": " << mapping.originals[pattern];
+            if (found[pattern]) {
+                std::cerr << " (found only inside longer matches or in collisions)";
+                shadowedCount++;
+            }
+            std::cerr << std::endl;
+            unmatchedCount++;
+        }
+
+        RunStats::global().setFileCounts(summary.processedCount, summary.errorCount, summary.skippedCount);
+        std::cout << "Data replacement completed. " << summary.processedCount << " files processed, " << summary.errorCount
+                  << " errors, " << summary.skippedCount << " unchanged. " << replacedCount << " replacements, "
+                  << collisionCount << " collisions, " << unmatchedCount << " unmatched patterns";
+        if (shadowedCount > 0) {
+            std::cout << " (" << shadowedCount << " found but never replaced)";
+        }
+        std::cout << "." << std::endl;
+    }
+
+    static int parsePadByte(const std::string& value) {
+        try {
+            size_t used = 0;
+            unsigned long byte = std::stoul(value, &used, 16);
+            if (used == value.size() && byte <= 0xFF) return static_cast<int>(byte);
+        } catch (const std::exception&) {
+        }
+        throw std::runtime_error("Invalid pad byte: " + value);
+    }
+
+    static size_t parseMegabytes(const std::string& value) {
+        unsigned long megabytes = 0;
+        try {
+            megabytes = std::stoul(value);
+        } catch (const std::exception&) {
+            throw std::runtime_error("Invalid memory budget: " + value);
+        }
+        if (megabytes == 0) {
+            throw std::runtime_error("Invalid memory budget: " + value);
+        }
+        return static_cast<size_t>(megabytes) << 20;
+    }
+
+    static unsigned parseMilliseconds(const std::string& value) {
+        try {
+            unsigned long milliseconds = std::stoul(value);
+            if (milliseconds <= 60000) return static_cast<unsigned>(milliseconds);
+        } catch (const std::exception&) {
+        }
+        throw std::runtime_error("Invalid debounce time: " + value);
+    }
+
+    void printUsage() const {
+        std::cout << "Usage:" << std::endl;
+        std::cout << "  Extract text: program -e <script file> <output text file>" << std::endl;
+        std::cout << "  Modify text: program -m <script file> <input text file>" << std::endl;
+        std::cout << "  Batch extract: program -be <input directory> <output directory>" << std::endl;
+        std::cout << "  Batch modify: program -bm <input directory> <output directory>" << std::endl;
+        std::cout << "  Archive extract: program -ae <script.bin> <output directory>" << std::endl;
+        std::cout << "  Archive repack: program -ar <script.bin> <input directory> <output script.bin>" << std::endl;
+        std::cout << "  Translation memory extract: program -te <input directory> <memory directory>" << std::endl;
+        std::cout << "  Translation memory apply: program -ta <memory directory> <script directory>" << std::endl;
+        std::cout << "  Build search index: program -ib <input directory> <index file>" << std::endl;
+        std::cout << "  Search: program -is <index file> <UTF-8 text>" << std::endl;
+        std::cout << "  Watch and modify on save: program -w <text directory> <script directory>" << std::endl;
+        std::cout << "  Create patch: program -pc <original directory> <modified directory> <patch file>" << std::endl;
+        std::cout << "  Apply patch: program -pa <original directory> <patch file> <output directory>" << std::endl;
+        std::cout << "  Replace in data files: program -dr <mapping file> <data file or directory> <output file or directory>" << std::endl;
+        std::cout << "Supported formats:";
+        for (const ScriptFormat* format : settings_.formats) {
+            std::cout << " " << format->name();
+        }
+        std::cout << std::endl;
+        std::cout << "Encrypted scripts (*.001) are decrypted in memory by -e, -m, -be, -bm, -ae and -ar and re-encrypted when written" << std::endl;
+        std::cout << "Options:" << std::endl;
+        std::cout << "  -j <N>           Number of worker threads for batch modes (0 = all cores, default 1)" << std::endl;
+        std::cout << "  --incremental    Batch modify: skip files unchanged since the last run (uses a manifest in the output directory)" << std::endl;
+        std::cout << "  --out-enc utf8   Extract: convert text to UTF-8" << std::endl;
+        std::cout << "  --script-enc <sjis|gbk>  Extract and -ib: encoding of the text in the scripts (default sjis)" << std::endl;
+        std::cout << "  --in-enc utf8    Modify: text files are UTF-8, convert to the --target encoding" << std::endl;
+        std::cout << "  --target <sjis|gbk>      Modify: encoding written into the scripts" << std::endl;
+        std::cout << "  --bundle         Batch and archive modes: read/write all texts as one bundle file instead of a directory of txt files" << std::endl;
+        std::cout << "  --io-uring       Batch modes: pipeline file reads and writes with io_uring (falls back to blocking I/O)" << std::endl;
+        std::cout << "  --memory-budget=<MB>     Batch modes: memory for files in flight; larger files wait, a file over the budget runs alone (default 64)" << std::endl;
+        std::cout << "  --pool-strings   Modify: store identical strings once and point suffixes into longer strings" << std::endl;
+        std::cout << "  --in-place       Modify: patch only the changed regions of the script file instead of rewriting it" << std::endl;
+        std::cout << "  --pad[=<hex>]    -dr: pad shorter translations with this byte (default 00) instead of rejecting them" << std::endl;
+        std::cout << "  --debounce=<ms>  Watch: wait this long after the last change of a text file before rebuilding (default 20)" << std::endl;
+        std::cout << "  --quiet          Do not print a line for every processed file" << std::endl;
+        std::cout << "  --stats=<file>   Write per-phase timings and counters as JSON" << std::endl;
+    }
+
+    ScriptToolSettings settings_;
+
+    // 命令行参数, 在run中解析, 处理过程中只读
+    unsigned jobs_ = 1;
+    bool incremental_ = false;
+    bool bundle_ = false;
+    bool ioUring_ = false;
+    size_t memoryBudget_ = 64 << 20;
+    bool inPlace_ = false;
+    int padByte_ = -1; // -dr中较短译文的填充字节, -1表示要求长度相同
+    BuildOptions buildOptions_;
+    bool quiet_ = false;
+    unsigned debounceMilliseconds_ = 20;
+    std::string statsPath_;
+    TextConversion conversion_;
+};
@@ -0,0 +1,251 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <stdexcept>
+#include <string_view>
+
+#include "byte_order.h"
+#include "scan_kernels.h"
+#include "script_layout.h"
+
+// 脚本的只读视图
+// 不复制也不拥有数据, 构造时只解析文件头, 第i个字符串通过索引表O(1)定位; 数据必须在视图使用期间保持有效
+
+// 一个文本段: 索引表的每一项为字符串在数据区域中的偏移, 字符串以\0结尾
+// 偏移不小于数据区域长度或超出文件时为空字符串; 字符串读到\0或limit为止, 不依赖偏移的顺序
+class SegmentView {
+public:
+    class iterator {
+    public:
+        using iterator_category = std::random_access_iterator_tag;
+        using value_type = std::string_view;
+        using difference_type = std::ptrdiff_t;
+        using pointer = void;
+        using reference = std::string_view;
+
+        iterator() = default;
+        iterator(const SegmentView* segment, size_t index) : segment_(segment), index_(index) {}
+
+        std::string_view operator*() const { return (*segment_)[index_]; }
+        std::string_view operator[](difference_type n) const { return (*segment_)[index_ + n]; }
+        iterator& operator++() { index_++; return *this; }
+        iterator operator++(int) { iterator old = *this; index_++; return old; }
+        iterator& operator--() { index_--; return *this; }
+        iterator operator--(int) { iterator old = *this; index_--; return old; }
+        iterator& operator+=(difference_type n) { index_ += n; return *this; }
+        iterator& operator-=(difference_type n) { index_ -= n; return *this; }
+        iterator operator+(difference_type n) const { return iterator(segment_, index_ + n); }
+        iterator operator-(difference_type n) const { return iterator(segment_, index_ - n); }
+        difference_type operator-(const iterator& other) const { return static_cast<difference_type>(index_ - other.index_); }
+        bool operator==(const iterator& other) const { return index_ == other.index_; }
+        bool operator!=(const iterator& other) const { return index_ != other.index_; }
+        bool operator<(const iterator& other) const { return index_ < other.index_; }
+
+        // 当前字符串在文本段中的序号
+        size_t index() const { return index_; }
+
+    private:
+        const SegmentView* segment_ = nullptr;
+        size_t index_ = 0;
+    };
+
+    SegmentView() = default;
+
+    // data为整个文件, 索引表从offsets开始共count项, 数据区域从dataStart开始, 长度dataLength; 字符串不超过limit
+    SegmentView(const uint8_t* data, const uint8_t* offsets, size_t count, size_t dataStart, size_t dataLength, size_t limit)
+        : data_(data), offsets_(offsets), count_(count), dataStart_(dataStart), dataLength_(dataLength), limit_(limit) {}
+
+    size_t size() const { return count_; }
+    bool empty() const { return count_ == 0; }
+
+    // 第i个字符串在数据区域中的偏移(索引表中的原始值)
+    uint32_t offset(size_t i) const {
+        return readLittleEndian32(offsets_ + i * 4);
+    }
+
+    std::string_view operator[](size_t i) const {
+        uint32_t textOffset = offset(i);
+        if (textOffset >= dataLength_) return std::string_view();
+        size_t start = dataStart_ + textOffset;
+        if (start >= limit_) return std::string_view();
+        const uint8_t* end = findByte(data_ + start, data_ + limit_, 0);
+        return std::string_view(reinterpret_cast<const char*>(data_ + start), end - (data_ + start));
+    }
+
+    iterator begin() const { return iterator(this, 0); }
+    iterator end() const { return iterator(this, count_); }
+
+private:
+    const uint8_t* data_ = nullptr;
+    const uint8_t* offsets_ = nullptr;
+    size_t count_ = 0;
+    size_t dataStart_ = 0;
+    size_t dataLength_ = 0;
+    size_t limit_ = 0;
+};
+
+// ESCR1_00脚本
+// 文件头"ESCR1_00", 字符串数量, 字符串偏移表, 字节码长度, 字节码, 文本段长度, 文本段;
+// 第一个字符串固定为空字符串, 不包含在视图的字符串中
+class Escr1_00View {
+public:
+    static bool matches(const uint8_t* data, size_t size) {
+        return size >= 8 && std::memcmp(data, Escr1_00Layout::magic, 8) == 0;
+    }
+
+    // 文件结构无效时抛出异常
+    Escr1_00View(const uint8_t* data, size_t size) : data_(data), size_(size) {
+        if (!matches(data, size)) {
+            throw std::runtime_error("Invalid ESCR1_00 file format");
+        }
+        if (size < Layout::indexTable) {
+            throw std::runtime_error("File too small");
+        }
+        strCount_ = readLittleEndian32(data + Layout::countField);
+
+        // 检查索引表大小
+        size_t indexTableSize = static_cast<size_t>(strCount_) * 4;
+        if (size < Layout::indexTable + indexTableSize + 4) {
+            throw std::runtime_error("Invalid file structure");
+        }
+
+        // 字节码之后是文本段长度和文本段
+        scriptSize_ = readLittleEndian32(data + Layout::indexTable + indexTableSize);
+        textSegmentPos_ = Layout::indexTable + indexTableSize + 4 + scriptSize_ + 4;
+        if (size < textSegmentPos_) {
+            throw std::runtime_error("Invalid file structure");
+        }
+        textSegmentSize_ = readLittleEndian32(data + textSegmentPos_ - 4);
+    }
+
+    using Layout = Escr1_00Layout;
+
+    size_t segmentCount() const { return Layout::segmentCount; }
+
+    // 字符串偏移表中除第一个空字符串以外的部分; 字符串可以延伸到文件末尾
+    SegmentView segment(size_t = 0) const {
+        return SegmentView(data_, data_ + Layout::indexTable + Layout::reservedStrings * 4, stringCount(), textSegmentPos_,
+                           textSegmentSize_, size_);
+    }
+
+    size_t stringCount() const { return strCount_ > Layout::reservedStrings ? strCount_ - Layout::reservedStrings : 0; }
+    std::string_view string(size_t i) const { return segment()[i]; }
+
+    // 索引表中的字符串数量(包括第一个空字符串)
+    uint32_t indexCount() const { return strCount_; }
+    // 字节码在文件中的位置和长度
+    size_t scriptPos() const { return Layout::indexTable + static_cast<size_t>(strCount_) * 4 + 4; }
+    uint32_t scriptSize() const { return scriptSize_; }
+    // 文本段在文件中的位置和文件头记录的长度
+    size_t textSegmentPos() const { return textSegmentPos_; }
+    uint32_t textSegmentSize() const { return textSegmentSize_; }
+
+private:
+    const uint8_t* data_;
+    size_t size_;
+    uint32_t strCount_ = 0;
+    uint32_t scriptSize_ = 0;
+    size_t textSegmentPos_ = 0;
+    uint32_t textSegmentSize_ = 0;
+};
+
+// @escu:de脚本
+// 文件头0x1C字节: 标识, 控制部分长度, 是否有两个文本段, 第一个文本段数据长度, 最后一个文本段字符串数量和数据长度;
+// 控制部分之后是一个或两个文本段, 每个文本段由索引表和数据区域组成, 位置由文件末尾向前推算
+class EscudeScriptView {
+public:
+    static bool matches(const uint8_t* data, size_t size) {
+        return size >= 8 && std::memcmp(data, EscudeScriptHeader::magic, 8) == 0;
+    }
+
+    // 文件结构无效时抛出异常
+    EscudeScriptView(const uint8_t* data, size_t size) : data_(data), size_(size) {
+        if (!matches(data, size) || size < EscudeScriptHeader::headerSize) {
+            throw std::runtime_error("Invalid escude script file");
+        }
+
+        // 文本部分从控制部分之后开始
+        controlLength_ = readLittleEndian32(data + EscudeScriptHeader::controlLengthField);
+        if (controlLength_ > size - EscudeScriptHeader::headerSize) {
+            throw std::runtime_error("Invalid escude script file");
+        }
+
+        hasTwoSegments_ = readLittleEndian32(data + EscudeScriptHeader::segmentsField) == 1;
+        if (hasTwoSegments_) {
+            locateSegments<EscudeScriptLayout<2>>();
+        } else {
+            locateSegments<EscudeScriptLayout<1>>();
+        }
+    }
+
+    // 文件头0x0C为1时有两个文本段; 为0时只有一个, 提取工具不输出这类文件的文本
+    bool hasTwoSegments() const { return hasTwoSegments_; }
+    uint32_t controlLength() const { return controlLength_; }
+
+    size_t segmentCount() const { return segmentCount_; }
+
+    // 索引表超出文件的部分忽略; 字符串不超过数据区域的结尾
+    SegmentView segment(size_t s) const {
+        const Segment& segment = segments_[s];
+        size_t limit = std::min<size_t>(static_cast<size_t>(segment.dataStart) + segment.dataLength, size_);
+        return SegmentView(data_, data_ + segment.indexStart, indexCount(s), segment.dataStart, segment.dataLength, limit);
+    }
+
+    // 文本段s的索引表项数
+    size_t indexCount(size_t s) const {
+        const Segment& segment = segments_[s];
+        size_t limit = std::min<size_t>(segment.indexEnd, size_ >= 4 ? size_ - 3 : 0);
+        return limit > segment.indexStart ? (limit - segment.indexStart + 3) / 4 : 0;
+    }
+
+    // 按重建时的顺序(所有文本段依次排列)访问字符串
+    size_t stringCount() const {
+        size_t count = 0;
+        for (size_t s = 0; s < segmentCount_; s++) {
+            count += indexCount(s);
+        }
+        return count;
+    }
+
+    std::string_view string(size_t i) const {
+        size_t firstCount = indexCount(0);
+        return i < firstCount ? segment(0)[i] : segment(1)[i - firstCount];
+    }
+
+private:
+    // 从最后一个文本段开始向前推算各文本段的位置, 与文件头一样按32位计算
+    template <typename Layout>
+    void locateSegments() {
+        uint32_t end = static_cast<uint32_t>(size_);
+        for (size_t s = Layout::segmentCount; s-- > 0;) {
+            uint32_t dataLength = readLittleEndian32(data_ + Layout::dataLengthFields[s]);
+            uint32_t dataStart = end - dataLength;
+            uint32_t indexStart = Layout::headerSize + controlLength_;
+            if (s > 0) {
+                indexStart = dataStart - readLittleEndian32(data_ + Layout::lastCountField) * 4;
+            }
+            segments_[s] = {indexStart, dataStart, dataStart, dataLength};
+            end = indexStart;
+        }
+        segmentCount_ = Layout::segmentCount;
+    }
+
+    // 文本段在文件中的位置: 索引表[indexStart, indexEnd), 数据区域从dataStart开始, 长度dataLength
+    struct Segment {
+        uint32_t indexStart;
+        uint32_t indexEnd;
+        uint32_t dataStart;
+        uint32_t dataLength;
+    };
+
+    const uint8_t* data_;
+    size_t size_;
+    uint32_t controlLength_ = 0;
+    bool hasTwoSegments_ = false;
+    Segment segments_[2] = {};
+    size_t segmentCount_ = 0;
+};
@@ -0,0 +1,373 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "byte_order.h"
+#include "file_writer.h"
+#include "mapped_file.h"
+
+// 全文搜索索引
+// 以UTF-8文本的3字节n-gram为键的倒排索引, 查询时取查询文本中所有n-gram的倒排表求交集, 再在候选字符串中确认;
+// 3字节正好是一个常用汉字或假名, 也覆盖ASCII的三个字符. 不足3字节的查询直接扫描所有字符串
+//
+// 文件结构(小端序), 查询时映射整个文件直接访问:
+//   文件头0x20字节: "ESSI0001", 文件数量, 字符串数量, n-gram数量, 路径区域长度, 文本区域长度, 倒排区域长度
+//   文件表: 每个文件8字节, 路径在路径区域中的偏移和长度
+//   字符串表: 每个字符串16字节, 文件序号, 文本段编号, 在文本段中的序号, 文本在文本区域中的偏移; 文本按字符串顺序连续存放
+//   n-gram表: 每项12字节, n-gram(3字节, 小端序存放在4字节中), 倒排表在倒排区域中的偏移, 字符串数量; 按n-gram升序
+//   路径区域, 文本区域(UTF-8, 不含结束符), 倒排区域
+// 倒排表为递增的字符串序号, 相邻序号之差按LEB128变长编码
+namespace search_index {
+
+constexpr char magic[] = "ESSI0001";
+constexpr size_t headerSize = 0x20;
+constexpr size_t fileEntrySize = 8;
+constexpr size_t stringEntrySize = 16;
+constexpr size_t gramEntrySize = 12;
+constexpr size_t gramLength = 3;
+constexpr uint32_t gramSpace = 1u << 24;
+
+// 依次输出文本中的每个n-gram(可能重复)
+template <typename Callback>
+inline void forEachGram(std::string_view text, Callback&& callback) {
+    for (size_t i = 0; i + gramLength <= text.size(); i++) {
+        callback(static_cast<uint32_t>(static_cast<uint8_t>(text[i])) |
+                 static_cast<uint32_t>(static_cast<uint8_t>(text[i + 1])) << 8 |
+                 static_cast<uint32_t>(static_cast<uint8_t>(text[i + 2])) << 16);
+    }
+}
+
+// 文本中不重复的n-gram, 结果按升序保存在grams中
+inline void distinctGrams(std::string_view text, std::vector<uint32_t>& grams) {
+    grams.clear();
+    forEachGram(text, [&](uint32_t gram) {
+        grams.push_back(gram);
+    });
+    std::sort(grams.begin(), grams.end());
+    grams.erase(std::unique(grams.begin(), grams.end()), grams.end());
+}
+
+} // namespace search_index
+
+// 生成搜索索引, 文件和字符串按加入的顺序编号
+class SearchIndexBuilder {
+public:
+    void addFile(std::string_view path) {
+        files_.push_back({static_cast<uint32_t>(paths_.size()), static_cast<uint32_t>(path.size())});
+        paths_.append(path);
+    }
+
+    // 加入当前文件(最后一次addFile)中的一个字符串, text为UTF-8
+    void addString(uint32_t segment, uint32_t index, std::string_view text) {
+        strings_.push_back({static_cast<uint32_t>(files_.size() - 1), segment, index, static_cast<uint32_t>(texts_.size())});
+        texts_.append(text);
+        if (texts_.size() > UINT32_MAX) {
+            throw std::runtime_error("Search index too large");
+        }
+    }
+
+    size_t stringCount() const { return strings_.size(); }
+
+    // 写出索引, 返回n-gram的数量
+    // 每个(n-gram, 字符串序号)对打包为一个64位整数后排序, 同一n-gram的序号连续且有序, 即为它的倒排表;
+    // 内存与实际出现的n-gram数量成正比, 与n-gram的取值范围无关
+    size_t write(const std::string& path) const {
+        using namespace search_index;
+        if (strings_.size() >= UINT32_MAX) {
+            throw std::runtime_error("Search index too large");
+        }
+
+        std::vector<uint64_t> pairs;
+        std::vector<uint32_t> grams;
+        for (uint32_t id = 0; id < strings_.size(); id++) {
+            distinctGrams(text(id), grams);
+            for (uint32_t gram : grams) {
+                pairs.push_back((static_cast<uint64_t>(gram) << 32) | id);
+            }
+        }
+        if (pairs.size() > UINT32_MAX) {
+            throw std::runtime_error("Search index too large");
+        }
+        std::sort(pairs.begin(), pairs.end());
+
+        // 倒排表变长编码, 同时生成n-gram表
+        std::vector<uint8_t> encoded;
+        std::vector<uint8_t> gramTable;
+        uint8_t entry[gramEntrySize];
+        for (size_t begin = 0; begin < pairs.size();) {
+            uint32_t gram = static_cast<uint32_t>(pairs[begin] >> 32);
+            size_t end = begin + 1;
+            while (end < pairs.size() && static_cast<uint32_t>(pairs[end] >> 32) == gram) end++;
+            if (encoded.size() > UINT32_MAX) {
+                throw std::runtime_error("Search index too large");
+            }
+            writeLittleEndian32(entry, gram);
+            writeLittleEndian32(entry + 4, static_cast<uint32_t>(encoded.size()));
+            writeLittleEndian32(entry + 8, static_cast<uint32_t>(end - begin));
+            gramTable.insert(gramTable.end(), entry, entry + gramEntrySize);
+
+            uint32_t previous = 0;
+            for (; begin < end; begin++) {
+                uint32_t id = static_cast<uint32_t>(pairs[begin]);
+                uint32_t delta = id - previous;
+                previous = id;
+                while (delta >= 0x80) {
+                    encoded.push_back(static_cast<uint8_t>(delta | 0x80));
+                    delta >>= 7;
+                }
+                encoded.push_back(static_cast<uint8_t>(delta));
+            }
+        }
+        if (encoded.size() > UINT32_MAX) {
+            throw std::runtime_error("Search index too large");
+        }
+        size_t gramCount = gramTable.size() / gramEntrySize;
+
+        BufferedSink output;
+        if (!output.open(path)) {
+            throw std::runtime_error("Cannot create output file: " + path);
+        }
+        auto write32 = [&](uint32_t value) {
+            uint8_t bytes[4];
+            writeLittleEndian32(bytes, value);
+            output.write(bytes, 4);
+        };
+
+        output.write(magic, 8);
+        write32(static_cast<uint32_t>(files_.size()));
+        write32(static_cast<uint32_t>(strings_.size()));
+        write32(static_cast<uint32_t>(gramCount));
+        write32(static_cast<uint32_t>(paths_.size()));
+        write32(static_cast<uint32_t>(texts_.size()));
+        write32(static_cast<uint32_t>(encoded.size()));
+
+        for (const FileEntry& file : files_) {
+            write32(file.pathOffset);
+            write32(file.pathLength);
+        }
+        for (const StringEntry& string : strings_) {
+            write32(string.file);
+            write32(string.segment);
+            write32(string.index);
+            write32(string.textOffset);
+        }
+        output.write(gramTable.data(), gramTable.size());
+        output.write(paths_.data(), paths_.size());
+        output.write(texts_.data(), texts_.size());
+        output.write(encoded.data(), encoded.size());
+        output.close();
+        return gramCount;
+    }
+
+private:
+    struct FileEntry {
+        uint32_t pathOffset;
+        uint32_t pathLength;
+    };
+
+    struct StringEntry {
+        uint32_t file;
+        uint32_t segment;
+        uint32_t index;
+        uint32_t textOffset;
+    };
+
+    std::string_view text(uint32_t id) const {
+        size_t end = id + 1 < strings_.size() ? strings_[id + 1].textOffset : texts_.size();
+        return std::string_view(texts_.data() + strings_[id].textOffset, end - strings_[id].textOffset);
+    }
+
+    std::vector<FileEntry> files_;
+    std::vector<StringEntry> strings_;
+    std::string paths_;
+    std::string texts_;
+};
+
+// 读取搜索索引, 所有数据直接在映射内存中访问
+class SearchIndex {
+public:
+    void open(const std::string& path) {
+        using namespace search_index;
+        if (!file_.open(path)) {
+            throw std::runtime_error("Cannot open search index: " + path);
+        }
+        const uint8_t* data = file_.data();
+        uint64_t size = file_.size();
+        if (size < headerSize || std::string_view(reinterpret_cast<const char*>(data), 8) != magic) {
+            invalid();
+        }
+
+        fileCount_ = readLittleEndian32(data + 0x08);
+        stringCount_ = readLittleEndian32(data + 0x0C);
+        gramCount_ = readLittleEndian32(data + 0x10);
+        uint32_t pathPoolSize = readLittleEndian32(data + 0x14);
+        textPoolSize_ = readLittleEndian32(data + 0x18);
+        postingSize_ = readLittleEndian32(data + 0x1C);
+
+        // 各区域必须正好到文件末尾
+        uint64_t filesPos = headerSize;
+        uint64_t stringsPos = filesPos + static_cast<uint64_t>(fileCount_) * fileEntrySize;
+        uint64_t gramsPos = stringsPos + static_cast<uint64_t>(stringCount_) * stringEntrySize;
+        uint64_t pathsPos = gramsPos + static_cast<uint64_t>(gramCount_) * gramEntrySize;
+        uint64_t textsPos = pathsPos + pathPoolSize;
+        uint64_t postingsPos = textsPos + textPoolSize_;
+        if (postingsPos + postingSize_ != size) {
+            invalid();
+        }
+        files_ = data + filesPos;
+        strings_ = data + stringsPos;
+        grams_ = data + gramsPos;
+        paths_ = reinterpret_cast<const char*>(data + pathsPos);
+        texts_ = reinterpret_cast<const char*>(data + textsPos);
+        postings_ = data + postingsPos;
+
+        for (uint32_t i = 0; i < fileCount_; i++) {
+            const uint8_t* entry = files_ + static_cast<size_t>(i) * fileEntrySize;
+            if (static_cast<uint64_t>(readLittleEndian32(entry)) + readLittleEndian32(entry + 4) > pathPoolSize) invalid();
+        }
+        uint32_t previousOffset = 0;
+        for (uint32_t i = 0; i < stringCount_; i++) {
+            const uint8_t* entry = stringEntry(i);
+            uint32_t textOffset = readLittleEndian32(entry + 12);
+            if (readLittleEndian32(entry) >= fileCount_ || textOffset < previousOffset || textOffset > textPoolSize_) invalid();
+            previousOffset = textOffset;
+        }
+        uint32_t previousGram = 0;
+        for (uint32_t i = 0; i < gramCount_; i++) {
+            const uint8_t* entry = gramEntry(i);
+            uint32_t gram = readLittleEndian32(entry);
+            if (gram >= gramSpace || (i > 0 && gram <= previousGram) || readLittleEndian32(entry + 4) > postingSize_) invalid();
+            previousGram = gram;
+        }
+    }
+
+    size_t fileCount() const { return fileCount_; }
+    size_t stringCount() const { return stringCount_; }
+
+    std::string_view filePath(uint32_t file) const {
+        const uint8_t* entry = files_ + static_cast<size_t>(file) * search_index::fileEntrySize;
+        return std::string_view(paths_ + readLittleEndian32(entry), readLittleEndian32(entry + 4));
+    }
+
+    uint32_t stringFile(uint32_t id) const { return readLittleEndian32(stringEntry(id)); }
+    uint32_t stringSegment(uint32_t id) const { return readLittleEndian32(stringEntry(id) + 4); }
+    uint32_t stringIndex(uint32_t id) const { return readLittleEndian32(stringEntry(id) + 8); }
+
+    std::string_view text(uint32_t id) const {
+        uint32_t begin = readLittleEndian32(stringEntry(id) + 12);
+        uint32_t end = id + 1 < stringCount_ ? readLittleEndian32(stringEntry(id + 1) + 12) : textPoolSize_;
+        return std::string_view(texts_ + begin, end - begin);
+    }
+
+    // 查找包含query的所有字符串, 结果为按升序排列的字符串序号
+    void search(std::string_view query, std::vector<uint32_t>& results) const {
+        results.clear();
+        if (query.size() < search_index::gramLength) {
+            for (uint32_t id = 0; id < stringCount_; id++) {
+                if (text(id).find(query) != std::string_view::npos) {
+                    results.push_back(id);
+                }
+            }
+            return;
+        }
+
+        // 从字符串最少的倒排表开始求交集, 任何一个n-gram不存在时没有结果
+        std::vector<uint32_t> grams;
+        search_index::distinctGrams(query, grams);
+        std::vector<uint32_t> lists;
+        for (uint32_t gram : grams) {
+            uint32_t i = findGram(gram);
+            if (i == gramCount_) return;
+            lists.push_back(i);
+        }
+        std::sort(lists.begin(), lists.end(), [&](uint32_t a, uint32_t b) {
+            return readLittleEndian32(gramEntry(a) + 8) < readLittleEndian32(gramEntry(b) + 8);
+        });
+
+        decodePostings(lists[0], results);
+        std::vector<uint32_t> list;
+        for (size_t k = 1; k < lists.size() && !results.empty(); k++) {
+            decodePostings(lists[k], list);
+            size_t kept = 0;
+            size_t j = 0;
+            for (uint32_t id : results) {
+                while (j < list.size() && list[j] < id) j++;
+                if (j == list.size()) break;
+                if (list[j] == id) results[kept++] = id;
+            }
+            results.resize(kept);
+        }
+
+        // n-gram都出现不代表连续出现, 确认候选字符串确实包含查询文本
+        results.erase(std::remove_if(results.begin(), results.end(), [&](uint32_t id) {
+            return text(id).find(query) == std::string_view::npos;
+        }), results.end());
+    }
+
+private:
+    [[noreturn]] static void invalid() {
+        throw std::runtime_error("Invalid search index file");
+    }
+
+    const uint8_t* stringEntry(uint32_t id) const {
+        return strings_ + static_cast<size_t>(id) * search_index::stringEntrySize;
+    }
+
+    const uint8_t* gramEntry(uint32_t i) const {
+        return grams_ + static_cast<size_t>(i) * search_index::gramEntrySize;
+    }
+
+    // 二分查找n-gram表, 找不到时返回gramCount_
+    uint32_t findGram(uint32_t gram) const {
+        uint32_t low = 0;
+        uint32_t high = gramCount_;
+        while (low < high) {
+            uint32_t middle = low + (high - low) / 2;
+            if (readLittleEndian32(gramEntry(middle)) < gram) {
+                low = middle + 1;
+            } else {
+                high = middle;
+            }
+        }
+        return low < gramCount_ && readLittleEndian32(gramEntry(low)) == gram ? low : gramCount_;
+    }
+
+    // 解码第i个n-gram的倒排表, 数据损坏时抛出异常
+    void decodePostings(uint32_t i, std::vector<uint32_t>& output) const {
+        const uint8_t* entry = gramEntry(i);
+        uint32_t count = readLittleEndian32(entry + 8);
+        size_t pos = readLittleEndian32(entry + 4);
+        output.resize(count);
+        uint64_t value = 0;
+        for (uint32_t k = 0; k < count; k++) {
+            uint64_t delta = 0;
+            for (unsigned shift = 0;; shift += 7) {
+                if (pos >= postingSize_ || shift > 28) invalid();
+                uint8_t byte = postings_[pos++];
+                delta |= static_cast<uint64_t>(byte & 0x7F) << shift;
+                if (!(byte & 0x80)) break;
+            }
+            value += delta;
+            if (value >= stringCount_ || (k > 0 && delta == 0)) invalid();
+            output[k] = static_cast<uint32_t>(value);
+        }
+    }
+
+    MappedFile file_;
+    uint32_t fileCount_ = 0;
+    uint32_t stringCount_ = 0;
+    uint32_t gramCount_ = 0;
+    uint32_t textPoolSize_ = 0;
+    uint32_t postingSize_ = 0;
+    const uint8_t* files_ = nullptr;
+    const uint8_t* strings_ = nullptr;
+    const uint8_t* grams_ = nullptr;
+    const char* paths_ = nullptr;
+    const char* texts_ = nullptr;
+    const uint8_t* postings_ = nullptr;
+};
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+#include <vector>
+
+// 文本段的字符串池
+// 字符串以\0结尾依次存放, 索引表保存每个字符串的偏移; 合并模式下相同的字符串只保存一份,
+// 一个字符串是另一个字符串的后缀时直接指向后者的尾部(与链接器合并字符串常量的方法相同)
+//
+// 合并方法: 按反转后的字符串排序, 后缀反转后是前缀, 所以某个字符串如果是其他字符串的后缀,
+// 排序后紧接在它后面的字符串一定以它结尾; 从后向前遍历一次即可确定每个字符串保存在哪个字符串中.
+// 排序为O(n log n)次比较, 保存的字符串保持原来的顺序
+class StringPool {
+public:
+    // 计算每个字符串的偏移, 返回池的总长度(包括结束符)
+    // texts在write之前必须保持有效
+    size_t build(const std::string_view* texts, size_t count, bool merge) {
+        texts_ = texts;
+        owners_.resize(count);
+        offsets_.resize(count);
+
+        if (merge && count > 1) {
+            order_.resize(count);
+            for (size_t i = 0; i < count; i++) {
+                order_[i] = static_cast<uint32_t>(i);
+            }
+            std::sort(order_.begin(), order_.end(), [texts](uint32_t a, uint32_t b) {
+                return reverseLess(texts[a], texts[b]);
+            });
+            owners_[order_[count - 1]] = order_[count - 1];
+            for (size_t k = count - 1; k-- > 0;) {
+                uint32_t i = order_[k];
+                uint32_t next = order_[k + 1];
+                owners_[i] = isSuffix(texts[i], texts[next]) ? owners_[next] : i;
+            }
+        } else {
+            for (size_t i = 0; i < count; i++) {
+                owners_[i] = static_cast<uint32_t>(i);
+            }
+        }
+
+        // 先为单独保存的字符串分配位置, 再计算合并的字符串在其中的偏移
+        size_t size = 0;
+        for (size_t i = 0; i < count; i++) {
+            if (owners_[i] == i) {
+                offsets_[i] = size;
+                size += texts[i].size() + 1;
+            }
+        }
+        size_ = size;
+        for (size_t i = 0; i < count; i++) {
+            uint32_t owner = owners_[i];
+            if (owner != i) {
+                offsets_[i] = offsets_[owner] + texts[owner].size() - texts[i].size();
+            }
+        }
+        return size;
+    }
+
+    // 池的总长度
+    size_t size() const { return size_; }
+
+    // 字符串i在池中的偏移
+    size_t offset(size_t i) const { return offsets_[i]; }
+
+    // 写出池的内容, pool的长度为build的返回值
+    void write(uint8_t* pool) const {
+        for (size_t i = 0; i < owners_.size(); i++) {
+            if (owners_[i] != i) continue;
+            std::string_view text = texts_[i];
+            std::memcpy(pool + offsets_[i], text.data(), text.size());
+            pool[offsets_[i] + text.size()] = 0;
+        }
+    }
+
+private:
+    // 从末尾开始逐字节比较
+    static bool reverseLess(std::string_view a, std::string_view b) {
+        size_t length = std::min(a.size(), b.size());
+        for (size_t k = 1; k <= length; k++) {
+            uint8_t x = static_cast<uint8_t>(a[a.size() - k]);
+            uint8_t y = static_cast<uint8_t>(b[b.size() - k]);
+            if (x != y) return x < y;
+        }
+        return a.size() < b.size();
+    }
+
+    static bool isSuffix(std::string_view suffix, std::string_view text) {
+        if (suffix.empty()) return true;
+        return suffix.size() <= text.size() &&
+               std::memcmp(text.data() + text.size() - suffix.size(), suffix.data(), suffix.size()) == 0;
+    }
+
+    const std::string_view* texts_ = nullptr;
+    std::vector<uint32_t> order_;
+    std::vector<uint32_t> owners_;
+    std::vector<size_t> offsets_;
+    size_t size_ = 0;
+};
@@ -0,0 +1,257 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "byte_order.h"
+#include "file_writer.h"
+#include "mapped_file.h"
+#include "xxhash64.h"
+
+// 文本包
+// 一个文件保存整个游戏所有脚本的文本, 代替每个脚本一个txt文件; 修改时映射整个文件, 直接引用其中的字符串
+// 每个脚本保存重建时需要的全部字符串(包括空字符串), 数量总是与脚本一致, 不依赖换行符切分
+//
+// 文件结构(小端序):
+//   文件头0x20字节: "ESTB0001", 脚本数量, 字符串数量, 哈希表槽位数量, 路径区域长度, 字符串区域长度, 保留
+//   脚本目录: 每个脚本16字节, 路径在路径区域中的偏移和长度, 第一个字符串的序号, 字符串数量; 按路径排序
+//   哈希表: 槽位数量为2的幂, 每个槽位为脚本序号 + 1(0表示空), 按路径的XXH64线性探测
+//   字符串偏移表: 字符串数量 + 1 项, 字符串i为字符串区域中的[offset[i], offset[i + 1])
+//   路径区域, 字符串区域
+namespace text_bundle {
+
+constexpr char magic[] = "ESTB0001";
+constexpr size_t headerSize = 0x20;
+constexpr size_t directoryEntrySize = 16;
+
+} // namespace text_bundle
+
+// 写入文本包的一个脚本, 字符串依次保存在pool中
+struct BundleScript {
+    std::string path;
+    std::string pool;
+    std::vector<uint32_t> lengths;
+
+    void add(std::string_view text) {
+        pool.append(text);
+        lengths.push_back(static_cast<uint32_t>(text.size()));
+    }
+};
+
+inline uint64_t bundlePathHash(std::string_view path) {
+    return XXHash64::hash(path.data(), path.size());
+}
+
+// 写出文本包, 脚本按路径排序
+inline void writeTextBundle(const std::string& path, const std::vector<BundleScript>& scripts) {
+    std::vector<size_t> order(scripts.size());
+    for (size_t i = 0; i < order.size(); i++) {
+        order[i] = i;
+    }
+    std::sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+        return scripts[a].path < scripts[b].path;
+    });
+
+    uint64_t stringCount = 0;
+    uint64_t pathPoolSize = 0;
+    uint64_t stringPoolSize = 0;
+    for (const BundleScript& script : scripts) {
+        stringCount += script.lengths.size();
+        pathPoolSize += script.path.size();
+        stringPoolSize += script.pool.size();
+    }
+    if (scripts.size() >= UINT32_MAX / 2 || stringCount >= UINT32_MAX || pathPoolSize > UINT32_MAX || stringPoolSize > UINT32_MAX) {
+        throw std::runtime_error("Text bundle too large");
+    }
+
+    size_t slotCount = 16;
+    while (slotCount < scripts.size() * 2) {
+        slotCount *= 2;
+    }
+    std::vector<uint32_t> slots(slotCount, 0);
+    for (size_t i = 0; i < order.size(); i++) {
+        size_t slot = bundlePathHash(scripts[order[i]].path) & (slotCount - 1);
+        while (slots[slot] != 0) {
+            slot = (slot + 1) & (slotCount - 1);
+        }
+        slots[slot] = static_cast<uint32_t>(i + 1);
+    }
+
+    BufferedSink output;
+    if (!output.open(path)) {
+        throw std::runtime_error("Cannot create output file: " + path);
+    }
+    auto write32 = [&](uint32_t value) {
+        uint8_t bytes[4];
+        writeLittleEndian32(bytes, value);
+        output.write(bytes, 4);
+    };
+
+    output.write(text_bundle::magic, 8);
+    write32(static_cast<uint32_t>(scripts.size()));
+    write32(static_cast<uint32_t>(stringCount));
+    write32(static_cast<uint32_t>(slotCount));
+    write32(static_cast<uint32_t>(pathPoolSize));
+    write32(static_cast<uint32_t>(stringPoolSize));
+    write32(0);
+
+    uint32_t pathOffset = 0;
+    uint32_t firstString = 0;
+    for (size_t i : order) {
+        const BundleScript& script = scripts[i];
+        write32(pathOffset);
+        write32(static_cast<uint32_t>(script.path.size()));
+        write32(firstString);
+        write32(static_cast<uint32_t>(script.lengths.size()));
+        pathOffset += script.path.size();
+        firstString += script.lengths.size();
+    }
+    for (uint32_t slot : slots) {
+        write32(slot);
+    }
+
+    uint32_t stringOffset = 0;
+    for (size_t i : order) {
+        for (uint32_t length : scripts[i].lengths) {
+            write32(stringOffset);
+            stringOffset += length;
+        }
+    }
+    write32(stringOffset);
+
+    for (size_t i : order) {
+        output.write(scripts[i].path.data(), scripts[i].path.size());
+    }
+    for (size_t i : order) {
+        output.write(scripts[i].pool.data(), scripts[i].pool.size());
+    }
+    output.close();
+}
+
+// 读取文本包, 所有字符串直接引用映射内存
+class TextBundle {
+public:
+    static constexpr size_t npos = static_cast<size_t>(-1);
+
+    void open(const std::string& path) {
+        if (!file_.open(path)) {
+            throw std::runtime_error("Cannot open text bundle: " + path);
+        }
+        const uint8_t* data = file_.data();
+        uint64_t size = file_.size();
+        if (size < text_bundle::headerSize ||
+            std::string_view(reinterpret_cast<const char*>(data), 8) != text_bundle::magic) {
+            invalid();
+        }
+
+        scriptCount_ = readLittleEndian32(data + 0x08);
+        stringCount_ = readLittleEndian32(data + 0x0C);
+        slotCount_ = readLittleEndian32(data + 0x10);
+        uint32_t pathPoolSize = readLittleEndian32(data + 0x14);
+        uint32_t stringPoolSize = readLittleEndian32(data + 0x18);
+
+        // 各区域必须正好到文件末尾
+        uint64_t directoryPos = text_bundle::headerSize;
+        uint64_t slotsPos = directoryPos + static_cast<uint64_t>(scriptCount_) * text_bundle::directoryEntrySize;
+        uint64_t offsetsPos = slotsPos + static_cast<uint64_t>(slotCount_) * 4;
+        uint64_t pathsPos = offsetsPos + (static_cast<uint64_t>(stringCount_) + 1) * 4;
+        uint64_t stringsPos = pathsPos + pathPoolSize;
+        if (stringsPos + stringPoolSize != size || slotCount_ == 0 || (slotCount_ & (slotCount_ - 1)) != 0 ||
+            slotCount_ <= scriptCount_) {
+            invalid();
+        }
+        directory_ = data + directoryPos;
+        slots_ = data + slotsPos;
+        offsets_ = data + offsetsPos;
+        paths_ = reinterpret_cast<const char*>(data + pathsPos);
+        strings_ = reinterpret_cast<const char*>(data + stringsPos);
+
+        for (uint32_t i = 0; i < scriptCount_; i++) {
+            const uint8_t* entry = directory_ + static_cast<size_t>(i) * text_bundle::directoryEntrySize;
+            uint64_t pathEnd = static_cast<uint64_t>(readLittleEndian32(entry)) + readLittleEndian32(entry + 4);
+            uint64_t stringEnd = static_cast<uint64_t>(readLittleEndian32(entry + 8)) + readLittleEndian32(entry + 12);
+            if (pathEnd > pathPoolSize || stringEnd > stringCount_) invalid();
+        }
+        for (uint32_t slot = 0; slot < slotCount_; slot++) {
+            if (readLittleEndian32(slots_ + static_cast<size_t>(slot) * 4) > scriptCount_) invalid();
+        }
+        if (offset(0) != 0 || offset(stringCount_) != stringPoolSize) invalid();
+        for (uint32_t i = 0; i < stringCount_; i++) {
+            if (offset(i) > offset(i + 1)) invalid();
+        }
+    }
+
+    size_t scriptCount() const { return scriptCount_; }
+
+    std::string_view scriptPath(size_t script) const {
+        const uint8_t* entry = directoryEntry(script);
+        return std::string_view(paths_ + readLittleEndian32(entry), readLittleEndian32(entry + 4));
+    }
+
+    size_t stringCount(size_t script) const {
+        return readLittleEndian32(directoryEntry(script) + 12);
+    }
+
+    // 脚本中的第index个字符串
+    std::string_view text(size_t script, size_t index) const {
+        uint32_t i = readLittleEndian32(directoryEntry(script) + 8) + static_cast<uint32_t>(index);
+        return std::string_view(strings_ + offset(i), offset(i + 1) - offset(i));
+    }
+
+    // 脚本所有字符串的总长度, 用作批处理的调度权重
+    size_t textSize(size_t script) const {
+        const uint8_t* entry = directoryEntry(script);
+        uint32_t first = readLittleEndian32(entry + 8);
+        return offset(first + readLittleEndian32(entry + 12)) - offset(first);
+    }
+
+    // 根据路径查找脚本, 找不到时返回npos
+    size_t find(std::string_view path) const {
+        size_t mask = slotCount_ - 1;
+        for (size_t slot = bundlePathHash(path) & mask;; slot = (slot + 1) & mask) {
+            uint32_t value = readLittleEndian32(slots_ + slot * 4);
+            if (value == 0) return npos;
+            if (scriptPath(value - 1) == path) return value - 1;
+        }
+    }
+
+    // 脚本文本的哈希, 用于增量修改; 与字符串的划分有关, 与在文本包中的位置无关
+    uint64_t hash(size_t script, uint64_t seed) const {
+        XXHash64 hasher(seed);
+        for (size_t i = 0; i < stringCount(script); i++) {
+            std::string_view value = text(script, i);
+            uint8_t length[4];
+            writeLittleEndian32(length, static_cast<uint32_t>(value.size()));
+            hasher.update(length, 4);
+            hasher.update(value.data(), value.size());
+        }
+        return hasher.digest();
+    }
+
+private:
+    [[noreturn]] static void invalid() {
+        throw std::runtime_error("Invalid text bundle file");
+    }
+
+    const uint8_t* directoryEntry(size_t script) const {
+        return directory_ + script * text_bundle::directoryEntrySize;
+    }
+
+    uint32_t offset(uint32_t i) const {
+        return readLittleEndian32(offsets_ + static_cast<size_t>(i) * 4);
+    }
+
+    MappedFile file_;
+    uint32_t scriptCount_ = 0;
+    uint32_t stringCount_ = 0;
+    uint32_t slotCount_ = 0;
+    const uint8_t* directory_ = nullptr;
+    const uint8_t* slots_ = nullptr;
+    const uint8_t* offsets_ = nullptr;
+    const char* paths_ = nullptr;
+    const char* strings_ = nullptr;
+};
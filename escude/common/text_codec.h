@@ -0,0 +1,297 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <iconv.h>
+
+#include "run_stats.h"
+
+// 文本编码转换
+// 游戏脚本中的原文为Shift-JIS(CP932), 翻译使用UTF-8, 汉化后写回脚本使用GBK
+// 转换使用查找表, ASCII字符直接复制; 查找表在第一次使用时根据系统iconv的字符集数据生成
+
+enum class TextEncoding {
+    Raw,      // 不转换, 保持脚本中的原始字节
+    Utf8,
+    ShiftJis, // CP932
+    Gbk,      // CP936
+};
+
+inline TextEncoding parseTextEncoding(const std::string& name) {
+    if (name == "raw") return TextEncoding::Raw;
+    if (name == "utf8" || name == "utf-8") return TextEncoding::Utf8;
+    if (name == "sjis" || name == "shift-jis" || name == "cp932") return TextEncoding::ShiftJis;
+    if (name == "gbk" || name == "cp936") return TextEncoding::Gbk;
+    throw std::runtime_error("Unknown text encoding: " + name);
+}
+
+inline const char* textEncodingName(TextEncoding encoding) {
+    switch (encoding) {
+        case TextEncoding::Utf8: return "UTF-8";
+        case TextEncoding::ShiftJis: return "Shift-JIS";
+        case TextEncoding::Gbk: return "GBK";
+        default: return "raw";
+    }
+}
+
+// 提取和修改时的编码设置
+struct TextConversion {
+    TextEncoding scriptEncoding = TextEncoding::ShiftJis; // 提取时脚本中文本的编码, 只能是Shift-JIS或GBK
+    TextEncoding outputEncoding = TextEncoding::Raw;      // 提取时txt文件的编码
+    TextEncoding inputEncoding = TextEncoding::Raw;       // 修改时txt文件的编码
+    TextEncoding targetEncoding = TextEncoding::Raw;      // 修改时写入脚本的编码
+
+    // 提取时是否需要把脚本中的文本转换为UTF-8
+    bool convertsOutput() const {
+        return outputEncoding == TextEncoding::Utf8;
+    }
+
+    // 修改时是否需要把UTF-8文本转换为目标编码
+    bool convertsInput() const {
+        return inputEncoding == TextEncoding::Utf8 && (targetEncoding == TextEncoding::ShiftJis || targetEncoding == TextEncoding::Gbk);
+    }
+
+    // 检查参数组合, 只支持双字节编码和UTF-8之间的转换
+    void validate() const {
+        if (outputEncoding != TextEncoding::Raw && outputEncoding != TextEncoding::Utf8) {
+            throw std::runtime_error("--out-enc only supports utf8");
+        }
+        if (inputEncoding != TextEncoding::Raw && inputEncoding != TextEncoding::Utf8) {
+            throw std::runtime_error("--in-enc only supports utf8");
+        }
+        if (inputEncoding == TextEncoding::Utf8 && !convertsInput()) {
+            throw std::runtime_error("--in-enc utf8 requires --target sjis or --target gbk");
+        }
+    }
+
+    // 修改结果与编码设置有关, 增量模式计算txt文件哈希时作为种子
+    uint64_t hashSeed() const {
+        return convertsInput() ? (static_cast<uint64_t>(inputEncoding) << 8) | static_cast<uint64_t>(targetEncoding) : 0;
+    }
+};
+
+namespace codec_detail {
+
+inline bool isSjisLead(uint8_t c) {
+    return (c >= 0x81 && c <= 0x9F) || (c >= 0xE0 && c <= 0xFC);
+}
+
+inline bool isGbkLead(uint8_t c) {
+    return c >= 0x81 && c <= 0xFE;
+}
+
+// 使用iconv生成双字节编码到Unicode的查找表, 下标为(首字节 << 8) | 尾字节, 单字节字符下标为字节值
+// 无法转换的位置为0
+inline std::vector<uint16_t> buildDecodeTable(const char* charset, bool (*isLead)(uint8_t)) {
+    iconv_t cd = iconv_open("UTF-16LE", charset);
+    if (cd == reinterpret_cast<iconv_t>(-1)) {
+        throw std::runtime_error(std::string("Charset not supported: ") + charset);
+    }
+
+    std::vector<uint16_t> table(0x10000, 0);
+    auto convert = [&](const char* input, size_t length) -> uint16_t {
+        char in[2];
+        std::memcpy(in, input, length);
+        char out[8];
+        char* inPtr = in;
+        char* outPtr = out;
+        size_t inLeft = length;
+        size_t outLeft = sizeof(out);
+        iconv(cd, nullptr, nullptr, nullptr, nullptr);
+        if (iconv(cd, &inPtr, &inLeft, &outPtr, &outLeft) == static_cast<size_t>(-1) || sizeof(out) - outLeft != 2) {
+            return 0;
+        }
+        return static_cast<uint16_t>(static_cast<uint8_t>(out[0]) | (static_cast<uint8_t>(out[1]) << 8));
+    };
+
+    for (int c = 0; c < 0x100; c++) {
+        if (c < 0x80) {
+            table[c] = static_cast<uint16_t>(c);
+        } else if (!isLead(static_cast<uint8_t>(c))) {
+            char single = static_cast<char>(c);
+            table[c] = convert(&single, 1);
+        }
+    }
+    for (int lead = 0x81; lead <= 0xFE; lead++) {
+        if (!isLead(static_cast<uint8_t>(lead))) continue;
+        for (int trail = 0x40; trail <= 0xFE; trail++) {
+            if (trail == 0x7F) continue;
+            char pair[2] = {static_cast<char>(lead), static_cast<char>(trail)};
+            table[(lead << 8) | trail] = convert(pair, 2);
+        }
+    }
+
+    iconv_close(cd);
+    return table;
+}
+
+// 由解码表生成Unicode到该编码的查找表, 同一字符有多个编码时使用第一个
+inline std::vector<uint16_t> invertTable(const std::vector<uint16_t>& decode) {
+    std::vector<uint16_t> encode(0x10000, 0);
+    for (uint32_t code = 1; code < 0x10000; code++) {
+        uint16_t unicode = decode[code];
+        if (unicode != 0 && encode[unicode] == 0) {
+            encode[unicode] = static_cast<uint16_t>(code);
+        }
+    }
+    return encode;
+}
+
+inline const std::vector<uint16_t>& sjisDecodeTable() {
+    static const std::vector<uint16_t> table = buildDecodeTable("CP932", isSjisLead);
+    return table;
+}
+
+inline const std::vector<uint16_t>& gbkDecodeTable() {
+    static const std::vector<uint16_t> table = buildDecodeTable("CP936", isGbkLead);
+    return table;
+}
+
+inline const std::vector<uint16_t>& sjisEncodeTable() {
+    static const std::vector<uint16_t> table = invertTable(sjisDecodeTable());
+    return table;
+}
+
+inline const std::vector<uint16_t>& gbkEncodeTable() {
+    static const std::vector<uint16_t> table = invertTable(gbkDecodeTable());
+    return table;
+}
+
+// 返回开头连续ASCII字符的数量, 每次检查8字节
+inline size_t asciiPrefix(const uint8_t* p, size_t length) {
+    size_t i = 0;
+    while (i + 8 <= length) {
+        uint64_t chunk;
+        std::memcpy(&chunk, p + i, 8);
+        if (chunk & 0x8080808080808080ULL) break;
+        i += 8;
+    }
+    while (i < length && p[i] < 0x80) {
+        i++;
+    }
+    return i;
+}
+
+inline void appendUtf8(std::string& out, uint32_t code) {
+    if (code < 0x80) {
+        out.push_back(static_cast<char>(code));
+    } else if (code < 0x800) {
+        out.push_back(static_cast<char>(0xC0 | (code >> 6)));
+        out.push_back(static_cast<char>(0x80 | (code & 0x3F)));
+    } else if (code < 0x10000) {
+        out.push_back(static_cast<char>(0xE0 | (code >> 12)));
+        out.push_back(static_cast<char>(0x80 | ((code >> 6) & 0x3F)));
+        out.push_back(static_cast<char>(0x80 | (code & 0x3F)));
+    } else {
+        out.push_back(static_cast<char>(0xF0 | (code >> 18)));
+        out.push_back(static_cast<char>(0x80 | ((code >> 12) & 0x3F)));
+        out.push_back(static_cast<char>(0x80 | ((code >> 6) & 0x3F)));
+        out.push_back(static_cast<char>(0x80 | (code & 0x3F)));
+    }
+}
+
+// 解码一个UTF-8字符, 非法序列返回0xFFFFFFFF并前进一个字节
+inline uint32_t decodeUtf8(const uint8_t*& p, const uint8_t* end) {
+    uint8_t c = *p++;
+    int extra;
+    uint32_t code;
+    if (c < 0x80) return c;
+    if ((c & 0xE0) == 0xC0) { extra = 1; code = c & 0x1F; }
+    else if ((c & 0xF0) == 0xE0) { extra = 2; code = c & 0x0F; }
+    else if ((c & 0xF8) == 0xF0) { extra = 3; code = c & 0x07; }
+    else return 0xFFFFFFFF;
+    if (end - p < extra) return 0xFFFFFFFF;
+    for (int i = 0; i < extra; i++) {
+        if ((p[i] & 0xC0) != 0x80) return 0xFFFFFFFF;
+        code = (code << 6) | (p[i] & 0x3F);
+    }
+    p += extra;
+    return code;
+}
+
+} // namespace codec_detail
+
+// 双字节编码(Shift-JIS/GBK)转换为UTF-8, 追加到out中, 无法解码的字节输出为U+FFFD
+inline void decodeToUtf8(TextEncoding from, const uint8_t* p, size_t length, std::string& out) {
+    PhaseTimer timer(StatPhase::Transcode);
+    const std::vector<uint16_t>& table = from == TextEncoding::Gbk ? codec_detail::gbkDecodeTable() : codec_detail::sjisDecodeTable();
+    bool (*isLead)(uint8_t) = from == TextEncoding::Gbk ? codec_detail::isGbkLead : codec_detail::isSjisLead;
+    const uint8_t* end = p + length;
+    while (p < end) {
+        size_t ascii = codec_detail::asciiPrefix(p, end - p);
+        out.append(reinterpret_cast<const char*>(p), ascii);
+        p += ascii;
+        if (p == end) break;
+
+        uint32_t code = 0;
+        if (isLead(*p) && p + 1 < end) {
+            code = table[(p[0] << 8) | p[1]];
+            p += 2;
+        } else {
+            code = table[*p];
+            p += 1;
+        }
+        codec_detail::appendUtf8(out, code != 0 ? code : 0xFFFD);
+    }
+}
+
+// UTF-8转换为双字节编码(Shift-JIS/GBK), 追加到out中
+// 无法编码的字符输出为'?', 其Unicode码点记录到failed中(非法UTF-8序列记为0xFFFFFFFF)
+inline void encodeFromUtf8(TextEncoding to, const uint8_t* p, size_t length, std::string& out, std::vector<uint32_t>& failed) {
+    const std::vector<uint16_t>& table = to == TextEncoding::Gbk ? codec_detail::gbkEncodeTable() : codec_detail::sjisEncodeTable();
+    const uint8_t* end = p + length;
+    while (p < end) {
+        size_t ascii = codec_detail::asciiPrefix(p, end - p);
+        out.append(reinterpret_cast<const char*>(p), ascii);
+        p += ascii;
+        if (p == end) break;
+
+        uint32_t code = codec_detail::decodeUtf8(p, end);
+        uint16_t encoded = code < 0x10000 ? table[code] : 0;
+        if (encoded == 0) {
+            failed.push_back(code);
+            out.push_back('?');
+        } else if (encoded < 0x100) {
+            out.push_back(static_cast<char>(encoded));
+        } else {
+            out.push_back(static_cast<char>(encoded >> 8));
+            out.push_back(static_cast<char>(encoded & 0xFF));
+        }
+    }
+}
+
+// 格式化无法编码的字符, 用于警告信息
+inline std::string describeCodePoint(uint32_t code) {
+    if (code == 0xFFFFFFFF) return "invalid UTF-8 sequence";
+    char buffer[16];
+    std::snprintf(buffer, sizeof(buffer), "U+%04X", code);
+    return buffer;
+}
+
+// 修改时转换txt文件中的一行文本, 结果写入out
+// 无法编码的字符按行写入警告, 格式为 "Warning: 文件:行号: ..."
+inline void convertInputLine(const TextConversion& conversion, const char* text, size_t length, std::string& out,
+                             const std::string& fileName, size_t lineNumber, std::ostream& warn) {
+    PhaseTimer timer(StatPhase::Transcode);
+    out.clear();
+    std::vector<uint32_t> failed;
+    encodeFromUtf8(conversion.targetEncoding, reinterpret_cast<const uint8_t*>(text), length, out, failed);
+    if (failed.empty()) return;
+
+    warn << "Warning: " << fileName << ":" << lineNumber << ": cannot encode ";
+    for (size_t i = 0; i < failed.size(); i++) {
+        warn << (i > 0 ? ", " : "") << describeCodePoint(failed[i]);
+    }
+    warn << " as " << textEncodingName(conversion.targetEncoding) << "\n";
+}
+
+// 跳过UTF-8文件开头的BOM
+inline size_t utf8BomLength(const uint8_t* data, size_t size) {
+    return size >= 3 && data[0] == 0xEF && data[1] == 0xBB && data[2] == 0xBF ? 3 : 0;
+}
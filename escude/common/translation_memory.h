@@ -0,0 +1,224 @@
+#pragma once
+
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "byte_order.h"
+#include "file_writer.h"
+#include "mapped_file.h"
+#include "xxhash64.h"
+
+// 全部脚本共用的翻译记忆
+// 游戏中相同的台词和界面文本在许多脚本中重复出现, 提取时对所有字符串去重, 每个不同的字符串只翻译一次,
+// 写回时按出现位置分发到每个脚本
+//
+// 翻译记忆目录包含两个文件:
+//   strings.txt  去重后的字符串, 每行一个, 按第一次出现的顺序排列, 行号(从0开始)即字符串ID
+//   strings.idx  出现位置索引, 小端序:
+//     "ESTM0001", 文件数量, 字符串数量, 出现次数
+//     文件表: 每个文件为 路径长度, 路径(相对于脚本目录), 文本段数量, 每个文本段的字符串数量
+//     出现位置起始表: 字符串数量 + 1 项, 字符串i的出现位置为[start[i], start[i + 1])
+//     出现位置: 按字符串ID排列, 每项为 文件序号, 文本段编号, 在文本段中的序号
+// 空字符串不计入翻译记忆, 写回时保持为空
+namespace translation_memory {
+
+constexpr char indexMagic[] = "ESTM0001";
+constexpr const char* stringsFileName = "strings.txt";
+constexpr const char* indexFileName = "strings.idx";
+
+struct Occurrence {
+    uint32_t file;
+    uint32_t segment;
+    uint32_t index;
+};
+
+struct FileRecord {
+    std::string path;
+    std::vector<uint32_t> segmentSizes;
+};
+
+} // namespace translation_memory
+
+// 字符串去重表
+// 开放寻址哈希表, 槽位只保存字符串ID, 哈希值由调用者预先计算(可以在工作线程中并行计算);
+// 表中的文本只是引用, 调用者保证在使用期间有效
+class StringInterner {
+public:
+    static uint64_t hash(std::string_view text) {
+        return XXHash64::hash(text.data(), text.size());
+    }
+
+    // 返回字符串ID, 新字符串的ID按加入顺序分配
+    uint32_t intern(std::string_view text, uint64_t textHash) {
+        if ((strings_.size() + 1) * 2 > slots_.size()) {
+            grow();
+        }
+        size_t mask = slots_.size() - 1;
+        for (size_t slot = textHash & mask;; slot = (slot + 1) & mask) {
+            uint32_t id = slots_[slot];
+            if (id == emptySlot) {
+                id = static_cast<uint32_t>(strings_.size());
+                if (id == emptySlot) {
+                    throw std::runtime_error("Too many unique strings");
+                }
+                slots_[slot] = id;
+                strings_.push_back(text);
+                hashes_.push_back(textHash);
+                return id;
+            }
+            if (hashes_[id] == textHash && strings_[id] == text) {
+                return id;
+            }
+        }
+    }
+
+    size_t size() const { return strings_.size(); }
+    std::string_view text(uint32_t id) const { return strings_[id]; }
+
+private:
+    static constexpr uint32_t emptySlot = UINT32_MAX;
+
+    void grow() {
+        size_t capacity = slots_.empty() ? 1024 : slots_.size() * 2;
+        slots_.assign(capacity, emptySlot);
+        size_t mask = capacity - 1;
+        for (uint32_t id = 0; id < strings_.size(); id++) {
+            size_t slot = hashes_[id] & mask;
+            while (slots_[slot] != emptySlot) {
+                slot = (slot + 1) & mask;
+            }
+            slots_[slot] = id;
+        }
+    }
+
+    std::vector<uint32_t> slots_;
+    std::vector<std::string_view> strings_;
+    std::vector<uint64_t> hashes_;
+};
+
+// 写出出现位置索引
+// occurrenceStart和occurrences为按字符串ID分组的出现位置
+inline void writeTranslationIndex(const std::string& path, const std::vector<translation_memory::FileRecord>& files,
+                                  const std::vector<uint32_t>& occurrenceStart,
+                                  const std::vector<translation_memory::Occurrence>& occurrences) {
+    BufferedSink output;
+    if (!output.open(path)) {
+        throw std::runtime_error("Cannot create output file: " + path);
+    }
+    auto write32 = [&](uint32_t value) {
+        uint8_t bytes[4];
+        writeLittleEndian32(bytes, value);
+        output.write(bytes, 4);
+    };
+
+    output.write(translation_memory::indexMagic, 8);
+    write32(static_cast<uint32_t>(files.size()));
+    write32(static_cast<uint32_t>(occurrenceStart.size() - 1));
+    write32(static_cast<uint32_t>(occurrences.size()));
+
+    for (const auto& file : files) {
+        write32(static_cast<uint32_t>(file.path.size()));
+        output.write(file.path.data(), file.path.size());
+        write32(static_cast<uint32_t>(file.segmentSizes.size()));
+        for (uint32_t size : file.segmentSizes) {
+            write32(size);
+        }
+    }
+    for (uint32_t start : occurrenceStart) {
+        write32(start);
+    }
+    for (const auto& occurrence : occurrences) {
+        write32(occurrence.file);
+        write32(occurrence.segment);
+        write32(occurrence.index);
+    }
+    output.close();
+}
+
+// 读取出现位置索引, 出现位置表直接在映射内存中访问
+class TranslationIndex {
+public:
+    void open(const std::string& path) {
+        if (!file_.open(path)) {
+            throw std::runtime_error("Cannot open translation index: " + path);
+        }
+        const uint8_t* data = file_.data();
+        size_t size = file_.size();
+        size_t pos = 0;
+        auto read32 = [&]() {
+            if (size - pos < 4) invalid();
+            uint32_t value = readLittleEndian32(data + pos);
+            pos += 4;
+            return value;
+        };
+
+        if (size < 20 || std::string_view(reinterpret_cast<const char*>(data), 8) != translation_memory::indexMagic) {
+            invalid();
+        }
+        pos = 8;
+        uint32_t fileCount = read32();
+        stringCount_ = read32();
+        occurrenceCount_ = read32();
+
+        files_.clear();
+        files_.reserve(fileCount);
+        for (uint32_t i = 0; i < fileCount; i++) {
+            translation_memory::FileRecord record;
+            uint32_t pathLength = read32();
+            if (size - pos < pathLength) invalid();
+            record.path.assign(reinterpret_cast<const char*>(data + pos), pathLength);
+            pos += pathLength;
+            uint32_t segmentCount = read32();
+            if ((size - pos) / 4 < segmentCount) invalid();
+            for (uint32_t s = 0; s < segmentCount; s++) {
+                record.segmentSizes.push_back(read32());
+            }
+            files_.push_back(std::move(record));
+        }
+
+        // 起始表和出现位置表必须正好到文件末尾
+        uint64_t tableSize = (static_cast<uint64_t>(stringCount_) + 1) * 4 + static_cast<uint64_t>(occurrenceCount_) * 12;
+        if (size - pos != tableSize) invalid();
+        starts_ = data + pos;
+        occurrences_ = starts_ + (static_cast<size_t>(stringCount_) + 1) * 4;
+        if (occurrenceStart(0) != 0 || occurrenceStart(stringCount_) != occurrenceCount_) invalid();
+        for (uint32_t id = 0; id < stringCount_; id++) {
+            if (occurrenceStart(id) > occurrenceStart(id + 1)) invalid();
+        }
+        for (uint32_t i = 0; i < occurrenceCount_; i++) {
+            translation_memory::Occurrence position = occurrence(i);
+            if (position.file >= files_.size()) invalid();
+            const std::vector<uint32_t>& segmentSizes = files_[position.file].segmentSizes;
+            if (position.segment >= segmentSizes.size() || position.index >= segmentSizes[position.segment]) invalid();
+        }
+    }
+
+    const std::vector<translation_memory::FileRecord>& files() const { return files_; }
+    uint32_t stringCount() const { return stringCount_; }
+    uint32_t occurrenceCount() const { return occurrenceCount_; }
+
+    // 字符串id的出现位置为[occurrenceStart(id), occurrenceStart(id + 1))
+    uint32_t occurrenceStart(uint32_t id) const {
+        return readLittleEndian32(starts_ + static_cast<size_t>(id) * 4);
+    }
+
+    translation_memory::Occurrence occurrence(uint32_t i) const {
+        const uint8_t* p = occurrences_ + static_cast<size_t>(i) * 12;
+        return {readLittleEndian32(p), readLittleEndian32(p + 4), readLittleEndian32(p + 8)};
+    }
+
+private:
+    [[noreturn]] static void invalid() {
+        throw std::runtime_error("Invalid translation index file");
+    }
+
+    MappedFile file_;
+    std::vector<translation_memory::FileRecord> files_;
+    uint32_t stringCount_ = 0;
+    uint32_t occurrenceCount_ = 0;
+    const uint8_t* starts_ = nullptr;
+    const uint8_t* occurrences_ = nullptr;
+};
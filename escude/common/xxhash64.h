@@ -0,0 +1,136 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+// XXH64哈希算法, 用于快速判断文件内容是否变化
+// 支持分多次输入数据, 结果与一次性计算相同
+class XXHash64 {
+public:
+    explicit XXHash64(uint64_t seed = 0) {
+        state_[0] = seed + prime1 + prime2;
+        state_[1] = seed + prime2;
+        state_[2] = seed;
+        state_[3] = seed - prime1;
+        seed_ = seed;
+    }
+
+    void update(const void* input, size_t length) {
+        const uint8_t* p = static_cast<const uint8_t*>(input);
+        const uint8_t* end = p + length;
+        totalLength_ += length;
+
+        // 先补齐上次剩余的不足32字节的数据
+        if (bufferSize_ + length < 32) {
+            std::memcpy(buffer_ + bufferSize_, p, length);
+            bufferSize_ += length;
+            return;
+        }
+        if (bufferSize_ > 0) {
+            size_t fill = 32 - bufferSize_;
+            std::memcpy(buffer_ + bufferSize_, p, fill);
+            p += fill;
+            processStripe(buffer_);
+            bufferSize_ = 0;
+        }
+
+        while (p + 32 <= end) {
+            processStripe(p);
+            p += 32;
+        }
+
+        bufferSize_ = static_cast<size_t>(end - p);
+        std::memcpy(buffer_, p, bufferSize_);
+    }
+
+    uint64_t digest() const {
+        uint64_t h;
+        if (totalLength_ >= 32) {
+            h = rotl(state_[0], 1) + rotl(state_[1], 7) + rotl(state_[2], 12) + rotl(state_[3], 18);
+            for (int i = 0; i < 4; i++) {
+                h = mergeRound(h, state_[i]);
+            }
+        } else {
+            h = seed_ + prime5;
+        }
+        h += totalLength_;
+
+        const uint8_t* p = buffer_;
+        const uint8_t* end = buffer_ + bufferSize_;
+        while (p + 8 <= end) {
+            h ^= round(0, read64(p));
+            h = rotl(h, 27) * prime1 + prime4;
+            p += 8;
+        }
+        if (p + 4 <= end) {
+            h ^= static_cast<uint64_t>(read32(p)) * prime1;
+            h = rotl(h, 23) * prime2 + prime3;
+            p += 4;
+        }
+        while (p < end) {
+            h ^= (*p) * prime5;
+            h = rotl(h, 11) * prime1;
+            p++;
+        }
+
+        h ^= h >> 33;
+        h *= prime2;
+        h ^= h >> 29;
+        h *= prime3;
+        h ^= h >> 32;
+        return h;
+    }
+
+    static uint64_t hash(const void* input, size_t length, uint64_t seed = 0) {
+        XXHash64 hasher(seed);
+        hasher.update(input, length);
+        return hasher.digest();
+    }
+
+private:
+    static constexpr uint64_t prime1 = 11400714785074694791ULL;
+    static constexpr uint64_t prime2 = 14029467366897019727ULL;
+    static constexpr uint64_t prime3 = 1609587929392839161ULL;
+    static constexpr uint64_t prime4 = 9650029242287828579ULL;
+    static constexpr uint64_t prime5 = 2870177450012600261ULL;
+
+    static uint64_t rotl(uint64_t x, int r) {
+        return (x << r) | (x >> (64 - r));
+    }
+
+    static uint64_t read64(const uint8_t* p) {
+        uint64_t v;
+        std::memcpy(&v, p, 8);
+        return v;
+    }
+
+    static uint32_t read32(const uint8_t* p) {
+        uint32_t v;
+        std::memcpy(&v, p, 4);
+        return v;
+    }
+
+    static uint64_t round(uint64_t acc, uint64_t input) {
+        acc += input * prime2;
+        acc = rotl(acc, 31);
+        return acc * prime1;
+    }
+
+    static uint64_t mergeRound(uint64_t acc, uint64_t val) {
+        acc ^= round(0, val);
+        return acc * prime1 + prime4;
+    }
+
+    void processStripe(const uint8_t* p) {
+        for (int i = 0; i < 4; i++) {
+            state_[i] = round(state_[i], read64(p + i * 8));
+        }
+    }
+
+    uint64_t state_[4];
+    uint64_t seed_;
+    uint64_t totalLength_ = 0;
+    uint8_t buffer_[32];
+    size_t bufferSize_ = 0;
+};
@@ -0,0 +1,230 @@
+#include "escude.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <new>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "../common/escr1_00_format.h"
+#include "../common/escude_script_format.h"
+#include "../common/mapped_file.h"
+#include "../common/script_view.h"
+
+// 打开的脚本: 文件头解析一次, 各文本段的视图直接指向脚本数据
+struct EscudeScript {
+    MappedFile file; // escude_open_file时持有映射
+    const uint8_t* data = nullptr;
+    size_t size = 0;
+    const ScriptFormat* format = nullptr;
+    int formatId = 0;
+    SegmentView segments[2];
+    uint32_t segmentCount = 0;
+};
+
+namespace {
+
+thread_local std::string lastError;
+
+int fail(int status, const std::string& message) {
+    lastError = message;
+    return status;
+}
+
+// 根据文件头选择格式并解析文本段
+int parseScript(EscudeScript* script) {
+    try {
+        if (Escr1_00View::matches(script->data, script->size)) {
+            Escr1_00View view(script->data, script->size);
+            script->format = &Escr1_00Format::instance();
+            script->formatId = ESCUDE_FORMAT_ESCR1_00;
+            script->segments[0] = view.segment();
+            script->segmentCount = 1;
+        } else if (EscudeScriptView::matches(script->data, script->size)) {
+            EscudeScriptView view(script->data, script->size);
+            script->format = &EscudeScriptFormat::instance();
+            script->formatId = ESCUDE_FORMAT_ESCUDE_SCRIPT;
+            script->segmentCount = static_cast<uint32_t>(view.segmentCount());
+            for (uint32_t s = 0; s < script->segmentCount; s++) {
+                script->segments[s] = view.segment(s);
+            }
+        } else {
+            return fail(ESCUDE_ERROR_FORMAT, "Unsupported script format");
+        }
+    } catch (const std::exception& e) {
+        return fail(ESCUDE_ERROR_FORMAT, e.what());
+    }
+    return ESCUDE_OK;
+}
+
+int openScript(EscudeScript* script, EscudeScript** result) {
+    int status = parseScript(script);
+    if (status != ESCUDE_OK) {
+        delete script;
+        return status;
+    }
+    *result = script;
+    return ESCUDE_OK;
+}
+
+// 构建修改后的脚本, 未修改的部分引用原数据
+int buildImage(const EscudeScript* script, const char* const* texts, const size_t* lengths, size_t count,
+               uint32_t flags, ScriptImage& image) {
+    if (!script || (count > 0 && (!texts || !lengths))) {
+        return fail(ESCUDE_ERROR_ARGUMENT, "Invalid argument");
+    }
+    size_t expected = 0;
+    for (uint32_t s = 0; s < script->segmentCount; s++) {
+        expected += script->segments[s].size();
+    }
+    if (count != expected) {
+        return fail(ESCUDE_ERROR_ARGUMENT, "Text count mismatch. Expected: " + std::to_string(expected) +
+                                               ", Got: " + std::to_string(count));
+    }
+
+    std::vector<std::string_view> newTexts(count);
+    for (size_t i = 0; i < count; i++) {
+        newTexts[i] = std::string_view(texts[i] ? texts[i] : "", texts[i] ? lengths[i] : 0);
+    }
+    BuildOptions options;
+    options.poolStrings = (flags & ESCUDE_BUILD_POOL_STRINGS) != 0;
+    std::ostream log(nullptr);
+    try {
+        script->format->buildModifiedScript(script->data, script->size, newTexts, options, image, log);
+    } catch (const std::bad_alloc&) {
+        return fail(ESCUDE_ERROR_ARGUMENT, "Out of memory");
+    } catch (const std::exception& e) {
+        return fail(ESCUDE_ERROR_ARGUMENT, e.what());
+    }
+    return ESCUDE_OK;
+}
+
+} // namespace
+
+extern "C" {
+
+uint32_t escude_abi_version(void) {
+    return ESCUDE_ABI_VERSION;
+}
+
+const char* escude_last_error(void) {
+    return lastError.c_str();
+}
+
+int escude_open_file(const char* path, EscudeScript** script) {
+    if (!path || !script) {
+        return fail(ESCUDE_ERROR_ARGUMENT, "Invalid argument");
+    }
+    EscudeScript* opened = new (std::nothrow) EscudeScript();
+    if (!opened) {
+        return fail(ESCUDE_ERROR_IO, "Out of memory");
+    }
+    if (!opened->file.open(path)) {
+        delete opened;
+        return fail(ESCUDE_ERROR_IO, std::string("Cannot open file: ") + path);
+    }
+    opened->data = opened->file.data();
+    opened->size = opened->file.size();
+    return openScript(opened, script);
+}
+
+int escude_open_memory(const void* data, size_t size, EscudeScript** script) {
+    if ((!data && size > 0) || !script) {
+        return fail(ESCUDE_ERROR_ARGUMENT, "Invalid argument");
+    }
+    EscudeScript* opened = new (std::nothrow) EscudeScript();
+    if (!opened) {
+        return fail(ESCUDE_ERROR_IO, "Out of memory");
+    }
+    opened->data = static_cast<const uint8_t*>(data);
+    opened->size = size;
+    return openScript(opened, script);
+}
+
+void escude_close(EscudeScript* script) {
+    delete script;
+}
+
+int escude_format(const EscudeScript* script) {
+    return script ? script->formatId : 0;
+}
+
+uint32_t escude_segment_count(const EscudeScript* script) {
+    return script ? script->segmentCount : 0;
+}
+
+uint32_t escude_string_count(const EscudeScript* script, uint32_t segment) {
+    if (!script || segment >= script->segmentCount) return 0;
+    return static_cast<uint32_t>(script->segments[segment].size());
+}
+
+int escude_get_string(const EscudeScript* script, uint32_t segment, uint32_t index, const char** text, size_t* length) {
+    return escude_get_strings(script, segment, index, 1, text, length);
+}
+
+int escude_get_strings(const EscudeScript* script, uint32_t segment, uint32_t first, uint32_t count,
+                       const char** texts, size_t* lengths) {
+    if (!script || (count > 0 && (!texts || !lengths))) {
+        return fail(ESCUDE_ERROR_ARGUMENT, "Invalid argument");
+    }
+    if (segment >= script->segmentCount) {
+        return fail(ESCUDE_ERROR_RANGE, "Segment out of range");
+    }
+    const SegmentView& view = script->segments[segment];
+    if (first > view.size() || count > view.size() - first) {
+        return fail(ESCUDE_ERROR_RANGE, "String index out of range");
+    }
+    for (uint32_t i = 0; i < count; i++) {
+        std::string_view text = view[first + i];
+        texts[i] = text.data();
+        lengths[i] = text.size();
+    }
+    return ESCUDE_OK;
+}
+
+int escude_build_file(const EscudeScript* script, const char* const* texts, const size_t* lengths, size_t count,
+                      uint32_t flags, const char* output_path) {
+    if (!output_path) {
+        return fail(ESCUDE_ERROR_ARGUMENT, "Invalid argument");
+    }
+    ScriptImage image;
+    int status = buildImage(script, texts, lengths, count, flags, image);
+    if (status != ESCUDE_OK) return status;
+    if (!image.writeTo(output_path)) {
+        return fail(ESCUDE_ERROR_IO, std::string("Cannot create output file: ") + output_path);
+    }
+    return ESCUDE_OK;
+}
+
+int escude_build_memory(const EscudeScript* script, const char* const* texts, const size_t* lengths, size_t count,
+                        uint32_t flags, void** output, size_t* output_size) {
+    if (!output || !output_size) {
+        return fail(ESCUDE_ERROR_ARGUMENT, "Invalid argument");
+    }
+    ScriptImage image;
+    int status = buildImage(script, texts, lengths, count, flags, image);
+    if (status != ESCUDE_OK) return status;
+
+    // 至少分配1字节, 使空结果也返回有效指针
+    size_t size = image.size();
+    uint8_t* buffer = static_cast<uint8_t*>(std::malloc(size > 0 ? size : 1));
+    if (!buffer) {
+        return fail(ESCUDE_ERROR_IO, "Out of memory");
+    }
+    uint8_t* pos = buffer;
+    for (int i = 0; i < image.partCount; i++) {
+        std::memcpy(pos, image.parts[i].iov_base, image.parts[i].iov_len);
+        pos += image.parts[i].iov_len;
+    }
+    *output = buffer;
+    *output_size = size;
+    return ESCUDE_OK;
+}
+
+void escude_free(void* buffer) {
+    std::free(buffer);
+}
+
+} // extern "C"
@@ -0,0 +1,89 @@
+#ifndef ESCUDE_H
+#define ESCUDE_H
+
+/*
+ * escude脚本解析库的C接口
+ * 打开脚本时只解析文件头, 字符串直接指向脚本数据(不以\0结尾, 使用返回的长度), 在escude_close之前有效;
+ * 接口只使用C类型, 可以由ctypes等FFI直接调用. 新版本只增加函数和常量, 不修改已有函数的含义
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if defined(_WIN32)
+#define ESCUDE_API __declspec(dllexport)
+#else
+#define ESCUDE_API __attribute__((visibility("default")))
+#endif
+
+/* 接口版本, 与escude_abi_version()的返回值比较 */
+#define ESCUDE_ABI_VERSION 1
+
+/* 返回值 */
+#define ESCUDE_OK 0
+#define ESCUDE_ERROR_IO 1       /* 无法读写文件 */
+#define ESCUDE_ERROR_FORMAT 2   /* 不是支持的格式或文件结构无效 */
+#define ESCUDE_ERROR_RANGE 3    /* 文本段或字符串序号超出范围 */
+#define ESCUDE_ERROR_ARGUMENT 4 /* 参数无效, 例如文本数量与索引表不一致 */
+
+/* 脚本格式 */
+#define ESCUDE_FORMAT_ESCR1_00 1
+#define ESCUDE_FORMAT_ESCUDE_SCRIPT 2
+
+/* 重建选项 */
+#define ESCUDE_BUILD_POOL_STRINGS 1 /* 合并相同的字符串和后缀 */
+
+typedef struct EscudeScript EscudeScript;
+
+ESCUDE_API uint32_t escude_abi_version(void);
+
+/* 当前线程最近一次失败的错误信息 */
+ESCUDE_API const char* escude_last_error(void);
+
+/* 映射并打开脚本文件 */
+ESCUDE_API int escude_open_file(const char* path, EscudeScript** script);
+
+/* 打开内存中的脚本, 不复制数据, data在escude_close之前必须保持有效 */
+ESCUDE_API int escude_open_memory(const void* data, size_t size, EscudeScript** script);
+
+ESCUDE_API void escude_close(EscudeScript* script);
+
+/* ESCUDE_FORMAT_*之一 */
+ESCUDE_API int escude_format(const EscudeScript* script);
+
+/* ESCR1_00只有一个文本段; @escu:de有一个或两个文本段 */
+ESCUDE_API uint32_t escude_segment_count(const EscudeScript* script);
+
+/* 文本段中的字符串数量, ESCR1_00不包括第一个空字符串; segment超出范围时返回0 */
+ESCUDE_API uint32_t escude_string_count(const EscudeScript* script, uint32_t segment);
+
+/* 第index个字符串, 偏移无效时为空字符串 */
+ESCUDE_API int escude_get_string(const EscudeScript* script, uint32_t segment, uint32_t index,
+                                 const char** text, size_t* length);
+
+/* 从first开始连续count个字符串, 写入texts和lengths, 减少逐个调用的开销 */
+ESCUDE_API int escude_get_strings(const EscudeScript* script, uint32_t segment, uint32_t first, uint32_t count,
+                                  const char** texts, size_t* lengths);
+
+/*
+ * 使用新文本重建脚本, 写入output_path
+ * texts按文本段依次排列, 数量等于所有文本段的字符串数量之和; 文本为脚本编码, 不需要以\0结尾
+ */
+ESCUDE_API int escude_build_file(const EscudeScript* script, const char* const* texts, const size_t* lengths,
+                                 size_t count, uint32_t flags, const char* output_path);
+
+/* 与escude_build_file相同, 结果写入新分配的内存, 由escude_free释放 */
+ESCUDE_API int escude_build_memory(const EscudeScript* script, const char* const* texts, const size_t* lengths,
+                                   size_t count, uint32_t flags, void** output, size_t* output_size);
+
+ESCUDE_API void escude_free(void* buffer);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,134 @@
+# 通过ctypes调用libescude, 读取和重建escude脚本
+# 默认加载与本文件同目录的libescude.so, 可以用环境变量ESCUDE_LIBRARY指定路径
+import ctypes
+import os
+
+ABI_VERSION = 1
+
+FORMAT_ESCR1_00 = 1
+FORMAT_ESCUDE_SCRIPT = 2
+
+BUILD_POOL_STRINGS = 1
+
+class EscudeError(Exception):
+    def __init__(self, status, message):
+        super().__init__(message)
+        self.status = status
+
+def loadLibrary(path=None):
+    if path is None:
+        path = os.environ.get('ESCUDE_LIBRARY')
+    if path is None:
+        path = os.path.join(os.path.dirname(os.path.abspath(__file__)), 'libescude.so')
+    lib = ctypes.CDLL(path)
+
+    handle = ctypes.c_void_p
+    texts = ctypes.POINTER(ctypes.c_char_p)
+    lengths = ctypes.POINTER(ctypes.c_size_t)
+    signatures = {
+        'escude_abi_version': (ctypes.c_uint32, []),
+        'escude_last_error': (ctypes.c_char_p, []),
+        'escude_open_file': (ctypes.c_int, [ctypes.c_char_p, ctypes.POINTER(handle)]),
+        'escude_open_memory': (ctypes.c_int, [ctypes.c_void_p, ctypes.c_size_t, ctypes.POINTER(handle)]),
+        'escude_close': (None, [handle]),
+        'escude_format': (ctypes.c_int, [handle]),
+        'escude_segment_count': (ctypes.c_uint32, [handle]),
+        'escude_string_count': (ctypes.c_uint32, [handle, ctypes.c_uint32]),
+        'escude_get_strings': (ctypes.c_int, [handle, ctypes.c_uint32, ctypes.c_uint32, ctypes.c_uint32,
+                                              ctypes.POINTER(ctypes.c_void_p), lengths]),
+        'escude_build_file': (ctypes.c_int, [handle, texts, lengths, ctypes.c_size_t, ctypes.c_uint32, ctypes.c_char_p]),
+        'escude_build_memory': (ctypes.c_int, [handle, texts, lengths, ctypes.c_size_t, ctypes.c_uint32,
+                                               ctypes.POINTER(ctypes.c_void_p), ctypes.POINTER(ctypes.c_size_t)]),
+        'escude_free': (None, [ctypes.c_void_p]),
+    }
+    for name, (restype, argtypes) in signatures.items():
+        function = getattr(lib, name)
+        function.restype = restype
+        function.argtypes = argtypes
+
+    version = lib.escude_abi_version()
+    if version != ABI_VERSION:
+        raise EscudeError(0, 'Unsupported libescude ABI version: %d' % version)
+    return lib
+
+_lib = None
+
+def library():
+    global _lib
+    if _lib is None:
+        _lib = loadLibrary()
+    return _lib
+
+def _check(status):
+    if status != 0:
+        raise EscudeError(status, library().escude_last_error().decode('utf-8', 'replace'))
+
+class Script:
+    # 打开脚本文件, 或者打开内存中的脚本(data为bytes, 不复制)
+    def __init__(self, path=None, data=None):
+        self._handle = ctypes.c_void_p()
+        self._data = data
+        lib = library()
+        if data is not None:
+            _check(lib.escude_open_memory(data, len(data), ctypes.byref(self._handle)))
+        else:
+            _check(lib.escude_open_file(os.fsencode(path), ctypes.byref(self._handle)))
+
+    def close(self):
+        if self._handle:
+            library().escude_close(self._handle)
+            self._handle = ctypes.c_void_p()
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, *args):
+        self.close()
+
+    def __del__(self):
+        self.close()
+
+    @property
+    def format(self):
+        return library().escude_format(self._handle)
+
+    def segmentCount(self):
+        return library().escude_segment_count(self._handle)
+
+    def stringCount(self, segment):
+        return library().escude_string_count(self._handle, segment)
+
+    # 文本段中的所有字符串, 每个字符串为脚本编码的bytes
+    def strings(self, segment):
+        count = self.stringCount(segment)
+        texts = (ctypes.c_void_p * count)()
+        lengths = (ctypes.c_size_t * count)()
+        _check(library().escude_get_strings(self._handle, segment, 0, count, texts, lengths))
+        return [ctypes.string_at(texts[i], lengths[i]) if lengths[i] else b'' for i in range(count)]
+
+    # 按重建时的顺序排列所有文本段的字符串
+    def allStrings(self):
+        result = []
+        for segment in range(self.segmentCount()):
+            result.extend(self.strings(segment))
+        return result
+
+    # 使用新文本(bytes, 按allStrings的顺序)重建脚本; 指定path时写入文件, 否则返回bytes
+    def build(self, texts, path=None, poolStrings=False):
+        count = len(texts)
+        textArray = (ctypes.c_char_p * count)(*texts)
+        lengthArray = (ctypes.c_size_t * count)(*[len(text) for text in texts])
+        flags = BUILD_POOL_STRINGS if poolStrings else 0
+        lib = library()
+        if path is not None:
+            _check(lib.escude_build_file(self._handle, textArray, lengthArray, count, flags, os.fsencode(path)))
+            return None
+
+        output = ctypes.c_void_p()
+        size = ctypes.c_size_t()
+        _check(lib.escude_build_memory(self._handle, textArray, lengthArray, count, flags,
+                                       ctypes.byref(output), ctypes.byref(size)))
+        try:
+            return ctypes.string_at(output, size.value)
+        finally:
+            lib.escude_free(output)
@@ -0,0 +1,12 @@
+#include "../common/allocation_hooks.h"
+#include "../common/escr1_00_format.h"
+#include "../common/escude_script_format.h"
+#include "../common/script_tool.h"
+
+// 同时支持ESCR1_00和@escu:de格式的脚本文本工具
+// 每个文件只读取一次, 根据文件头选择格式, 批量模式输出到同一个目录并汇总所有错误
+int main(int argc, char* argv[]) {
+    ScriptToolSettings settings;
+    settings.formats = {&Escr1_00Format::instance(), &EscudeScriptFormat::instance()};
+    return ScriptTool(settings).run(argc, argv);
+}